@@ -53,21 +53,46 @@ unsigned int FindFragments(OBMol mol, vector<vector<int> >& rigid_fragments,
 {
 	unsigned int best_root_atom = 1;
 	unsigned int shortest_maximal_remaining_subgraph = mol.NumAtoms();
-	for (unsigned int i = 1; i <= mol.NumAtoms(); i++)
-	//finds the root atom by copying the molecule, deleting each atom in turn, and finding the sizes of the resulting pieces
+	//finds the root atom by deleting each atom in turn and finding the sizes
+	//of the resulting pieces; this used to delete it from a copy of the
+	//molecule and call ContigFragList, but walking the bond graph while
+	//skipping the atom gives the same sizes without a copy per atom
+	unsigned int n = mol.NumAtoms();
+	vector<vector<unsigned int> > nbrs(n + 1);
+	FOR_BONDS_OF_MOL(b, mol)
 	{
-		OBMol mol_pieces = mol;
-		OBAtom * atom_to_del = mol_pieces.GetAtom(i);
-		vector<vector<int> > frag_list;
-
-		mol_pieces.DeleteAtom(atom_to_del, true);
-		mol_pieces.ContigFragList(frag_list);
+		nbrs[b->GetBeginAtomIdx()].push_back(b->GetEndAtomIdx());
+		nbrs[b->GetEndAtomIdx()].push_back(b->GetBeginAtomIdx());
+	}
+	vector<unsigned int> seen(n + 1, 0); //i if visited while deleting i
+	vector<unsigned int> pending;
+	for (unsigned int i = 1; i <= n; i++)
+	{
+		seen[i] = i;
 		unsigned int smrsi = 0;
-		for (unsigned int j = 0; j < frag_list.size(); j++)
+		for (unsigned int start = 1; start <= n; start++)
 		{
-			smrsi = smrsi > frag_list.at(j).size() ?
-														smrsi :
-														frag_list.at(j).size();
+			if (seen[start] == i)
+				continue;
+			unsigned int size = 0;
+			seen[start] = i;
+			pending.push_back(start);
+			while (!pending.empty())
+			{
+				unsigned int a = pending.back();
+				pending.pop_back();
+				size++;
+				for (unsigned int k = 0; k < nbrs[a].size(); k++)
+				{
+					unsigned int nbr = nbrs[a][k];
+					if (seen[nbr] != i)
+					{
+						seen[nbr] = i;
+						pending.push_back(nbr);
+					}
+				}
+			}
+			smrsi = smrsi > size ? smrsi : size;
 		}
 		if (smrsi < shortest_maximal_remaining_subgraph)
 		{
@@ -337,19 +362,69 @@ void createSDFContext(OBMol& mol, vector<OBAtom*> atoms, sdfcontext& sc)
 	}
 }
 
+//the AutoDock type name written for atom
+string ADTypeName(OBAtom* atom)
+{
+	const char *element_name = GET_SYMBOL(atom->GetAtomicNum());
+	char element_name_final[3];
+	element_name_final[2] = '\0';
+
+	if (atom->GetAtomicNum() == 1)
+	{
+		element_name_final[0] = 'H';
+		element_name_final[1] = 'D';
+	}
+	else if ((atom->GetAtomicNum() == 6) && (atom->IsAromatic()))
+	{
+		element_name_final[0] = 'A';
+		element_name_final[1] = '\0';
+	}
+	else if (atom->GetAtomicNum() == 8)
+	{
+		element_name_final[0] = 'O';
+		element_name_final[1] = 'A';
+	}
+	else if ((atom->GetAtomicNum() == 7) && (atom->IsHbondAcceptor()))
+	{
+		element_name_final[0] = 'N';
+		element_name_final[1] = 'A';
+	}
+	else if ((atom->GetAtomicNum() == 16) && (atom->IsHbondAcceptor()))
+	{
+		element_name_final[0] = 'S';
+		element_name_final[1] = 'A';
+	}
+	else
+	{
+		if (!isalnum(element_name[0]))
+		{
+			element_name_final[0] = '\0';
+		}
+		else
+			element_name_final[0] = element_name[0];
+		if (!isalnum(element_name[1]))
+		{
+			element_name_final[1] = '\0'; //null terminate
+		}
+		else
+			element_name_final[1] = element_name[1];
+	}
+	return element_name_final;
+}
+
+//with pdbqtcontext, the ATOM line is added to lines as the pdbqt parser
+//would have, in standard PDB columns
 static void OutputAtom(OBAtom* atom, context& lines, vector<OBAtom*>& atomorder,
 		parsing_struct& p,
-		const unsigned int index, unsigned immobile_num)
+		const unsigned int index, unsigned immobile_num, bool pdbqtcontext)
 {
 	char buffer[BUFF_SIZE];
 	char type_name[10], padded_name[10];
 	char the_res[10];
 	char the_chain = ' ';
-	const char *element_name;
-	string element_name_string;
+	char the_icode = ' ';
 	int res_num;
 	bool het = false;
-	stringstream ofs;
 
 	OBResidue *res;
 	strncpy(type_name, GET_SYMBOL(atom->GetAtomicNum()), sizeof(type_name));
@@ -371,6 +446,8 @@ static void OutputAtom(OBAtom* atom, context& lines, vector<OBAtom*>& atomorder,
 		snprintf(the_res, 4, "%s", (char*) res->GetName().c_str());
 		snprintf(type_name, 5, "%s", (char*) res->GetAtomID(atom).c_str());
 		the_chain = res->GetChain();
+		if (res->GetInsertionCode() > 0)
+			the_icode = res->GetInsertionCode();
 
 		//two char. elements are on position 13 and 14 one char. start at 14
 		if (strlen(GET_SYMBOL(atom->GetAtomicNum())) == 1)
@@ -399,72 +476,32 @@ static void OutputAtom(OBAtom* atom, context& lines, vector<OBAtom*>& atomorder,
 		res_num = 1;
 	}
 
-	element_name = GET_SYMBOL(atom->GetAtomicNum());
-	char element_name_final[3];
-	element_name_final[2] = '\0';
+	string element_name_final = ADTypeName(atom);
 
-	if (atom->GetAtomicNum() == 1)
-	{
-		element_name_final[0] = 'H';
-		element_name_final[1] = 'D';
-	}
-	else if ((atom->GetAtomicNum() == 6) && (atom->IsAromatic()))
-	{
-		element_name_final[0] = 'A';
-		element_name_final[1] = '\0';
-	}
-	else if (atom->GetAtomicNum() == 8)
-	{
-		element_name_final[0] = 'O';
-		element_name_final[1] = 'A';
-	}
-	else if ((atom->GetAtomicNum() == 7) && (atom->IsHbondAcceptor()))
-	{
-		element_name_final[0] = 'N';
-		element_name_final[1] = 'A';
-	}
-	else if ((atom->GetAtomicNum() == 16) && (atom->IsHbondAcceptor()))
-	{
-		element_name_final[0] = 'S';
-		element_name_final[1] = 'A';
-	}
-	else
+	double charge = atom->GetPartialCharge();
+	if (pdbqtcontext)
 	{
-		if (!isalnum(element_name[0]))
-		{
-			element_name_final[0] = '\0';
-		}
-		else
-			element_name_final[0] = element_name[0];
-		if (!isalnum(element_name[1]))
-		{
-			element_name_final[1] = '\0'; //null terminate
-		}
-		else
-			element_name_final[1] = element_name[1];
+		snprintf(buffer, BUFF_SIZE,
+				"%s%5d %-4s %-3s %c%4d%c   %8.3f%8.3f%8.3f  0.00  0.00    %+5.3f %.2s",
+				het ? "HETATM" : "ATOM  ",
+				index,
+				type_name,
+				the_res,
+				the_chain,
+				res_num,
+				the_icode,
+				atom->GetX(),
+				atom->GetY(),
+				atom->GetZ(),
+				charge,
+				element_name_final.c_str());
+		add_pdbqt_context(lines, buffer);
 	}
 
-	double charge = atom->GetPartialCharge();
-	snprintf(buffer, BUFF_SIZE,
-			"%s%5d %-4s %-3s %c%3d     %8.3f%8.3f%8.3f  0.00  0.00    %+5.3f %.2s",
-			het ? "HETATM" : "ATOM  ",
-			index,
-			type_name,
-			the_res,
-			the_chain,
-			res_num,
-			atom->GetX(),
-			atom->GetY(),
-			atom->GetZ(),
-			charge,
-			element_name_final);
-	ofs << buffer;
-
 	smt sm = string_to_smina_type(element_name_final);
 	assert(sm < smina_atom_type::NumTypes);
 	parsed_atom patom(sm, charge, vec(atom->GetX(), atom->GetY(), atom->GetZ()),
 			index);
-	//add_pdbqt_context(lines, ofs.str());
 	if (patom.number == immobile_num)
 		p.immobile_atom = p.atoms.size();
 	p.add(patom, lines, atomorder.size());
@@ -476,29 +513,34 @@ static void OutputAtom(OBAtom* atom, context& lines, vector<OBAtom*>& atomorder,
 static void OutputGroup(OBMol& mol, context& lines, vector<OBAtom*>& atomorder,
 		parsing_struct& p,
 		unsigned immobile_num,
-		const vector<int>& group, map<unsigned int, unsigned int> new_indexes)
+		const vector<int>& group, map<unsigned int, unsigned int> new_indexes,
+		bool pdbqtcontext)
 {
 	for (vector<int>::const_iterator it = group.begin(); it != group.end();
 			it++)
 	{
 		OutputAtom(mol.GetAtom((*it)), lines, atomorder, p,
 				new_indexes.find(*it)->second,
-				immobile_num);
+				immobile_num, pdbqtcontext);
 	}
 }
 
 //this we actually modify - we want the pdbqt output for the context, but
 //also want to build up the parallel smina data structure for output
+//with pdbqtcontext, lines gets the pdbqt text instead of an sdf context and
+//the fixed rotable hydrogens setting is left alone, so the result is what
+//the pdbqt parser would produce from OpenBabel's pdbqt output
 bool OutputTree(OBMol& mol, context& lines, parsing_struct& p,
 		map<unsigned int, obbranch> & tree,
-		unsigned int depth)
+		unsigned int depth, bool pdbqtcontext)
 {
 	if (tree.size() == 0)
 	{
 		return false;
 	}
 
-	set_fixed_rotable_hydrogens(true);
+	if (!pdbqtcontext)
+		set_fixed_rotable_hydrogens(true);
 
 	if (depth >= tree.size() - 1)
 	{
@@ -532,17 +574,19 @@ bool OutputTree(OBMol& mol, context& lines, parsing_struct& p,
 	stack<pair<unsigned, unsigned> > bnumstack;
 
 	//no legacy pdbqt context for smina output
-	//add_pdbqt_context(lines, "ROOT");
+	if (pdbqtcontext)
+		add_pdbqt_context(lines, "ROOT");
 	for (set<unsigned int>::iterator it =
 			tree[0].rigid_with.begin();
 			it != tree[0].rigid_with.end(); it++)
 	{
 		OutputGroup(mol, lines, atomorder, pstack.top(), INT_MAX,
 				tree[*it].atoms,
-				new_order);
+				new_order, pdbqtcontext);
 	}
 
-	//add_pdbqt_context(lines, "ENDROOT");
+	if (pdbqtcontext)
+		add_pdbqt_context(lines, "ENDROOT");
 
 	for (unsigned int i = 1; i < tree.size(); i++)
 	{
@@ -560,13 +604,14 @@ bool OutputTree(OBMol& mol, context& lines, parsing_struct& p,
 
 		pstack.push(parsing_struct());
 		bnumstack.push(make_pair(parnum, childnum)); //keep track of the parent number for this fragment
-		//add_pdbqt_context(lines, ofs.str());
+		if (pdbqtcontext)
+			add_pdbqt_context(lines, ofs.str());
 
 		for (set<unsigned int>::iterator it = tree[i].rigid_with.begin();
 				it != tree[i].rigid_with.end(); it++)
 		{
 			OutputGroup(mol, lines, atomorder, pstack.top(), childnum,
-					tree[*it].atoms, new_order);
+					tree[*it].atoms, new_order, pdbqtcontext);
 		}
 
 		for (vector<unsigned int>::iterator it = tree[i].parents.end();
@@ -609,13 +654,15 @@ bool OutputTree(OBMol& mol, context& lines, parsing_struct& p,
 				else
 					pstack.top().atoms[pos].ps.push_back(branch);
 
-				//add_pdbqt_context(lines, ofs.str());
+				if (pdbqtcontext)
+					add_pdbqt_context(lines, ofs.str());
 				tree[*it_parent].children.erase(*it);
 			}
 		}
 	}
 
-	createSDFContext(mol, atomorder, lines.sdftext);
+	if (!pdbqtcontext)
+		createSDFContext(mol, atomorder, lines.sdftext);
 	assert(pstack.size() == 1);
 	assert(bnumstack.size() == 0);
 	p = pstack.top();
@@ -98,11 +98,13 @@ bool FindBondedPiece(const std::vector<int>& root, const std::vector<int>& branc
 		unsigned int& root_atom_rank, unsigned int& branch_atom_rank,
 		const OpenBabel::OBMol& mol, unsigned int & atoms_moved);
 bool OutputTree(OpenBabel::OBMol& mol, context& lines, parsing_struct& p,
-		std::map<unsigned int, obbranch>& tree, unsigned int depth);
+		std::map<unsigned int, obbranch>& tree, unsigned int depth,
+		bool pdbqtcontext = false);
 void ConstructTree(std::map<unsigned int, obbranch>& tree,
 		std::vector<std::vector<int> > rigid_fragments, unsigned int root_piece,
 		const OpenBabel::OBMol& mol, bool flexible);
 bool DeleteHydrogens(OpenBabel::OBMol & mol);
+std::string ADTypeName(OpenBabel::OBAtom* atom);
 bool Separate_preserve_charges(OpenBabel::OBMol & mol, std::vector<OpenBabel::OBMol> & result);
 unsigned int FindFragments(OpenBabel::OBMol mol,
 		std::vector<std::vector<int> >& rigid_fragments, unsigned desired_root, const std::vector<int>& norotate);
@@ -132,7 +132,7 @@ unsigned convertParsing(OpenBabel::OBMol& mol, parsing_struct& p, context& c, bo
 }
 
 template<class T>
-static void convert(OBMol& mol, T& serialout, ostream& out, int rootatom,
+static unsigned convert(OBMol& mol, T& serialout, ostream& out, int rootatom,
 		const vector<int>& norotate)
 {
 	parsing_struct p;
@@ -141,6 +141,7 @@ static void convert(OBMol& mol, T& serialout, ostream& out, int rootatom,
 	serialout << torsdof;
 	serialout << p;
 	serialout << c;
+	return torsdof;
 }
 
 //text output
@@ -159,7 +160,7 @@ void convertText(OpenBabel::OBMol& mol, std::ostream& out)
 }
 
 //binary output
-void convertBinary(OBMol& mol, ostream& out, int rootatom,
+unsigned convertBinary(OBMol& mol, ostream& out, int rootatom,
 		const vector<int>& norotate)
 {
 	//by definition, smina format is gzipped
@@ -169,13 +170,101 @@ void convertBinary(OBMol& mol, ostream& out, int rootatom,
 
 	boost::archive::binary_oarchive serialout(strm,
 			boost::archive::no_header | boost::archive::no_tracking);
-	convert(mol, serialout, strm, rootatom, norotate);
+	return convert(mol, serialout, strm, rootatom, norotate);
 }
 
-void convertBinary(OpenBabel::OBMol& mol, std::ostream& out)
+unsigned convertBinary(OpenBabel::OBMol& mol, std::ostream& out)
 {
 	std::vector<int> nr;
-	convertBinary(mol, out, 0, nr);
+	return convertBinary(mol, out, 0, nr);
+}
+
+//the atoms of the rigid part, in order, as written with the r option
+static void convertRigid(OBMol& mol, rigid& r)
+{
+	DeleteHydrogens(mol);
+	mol.SetAutomaticFormalCharge(false);
+
+	r.atoms.reserve(mol.NumAtoms());
+	unsigned index = 1;
+	FOR_ATOMS_OF_MOL(a, mol)
+	{
+		string name = ADTypeName(&*a);
+		parsed_atom pa(string_to_smina_type(name), a->GetPartialCharge(),
+				vec(a->GetX(), a->GetY(), a->GetZ()), index);
+		if (!pa.acceptable_type())
+			throw parse_error(mol.GetTitle(), index,
+					"\"" + name + "\" is not a valid AutoDock type");
+		r.atoms.push_back(pa);
+		index++;
+	}
+}
+
+//a flexible residue, as written with the s option: rooted at the CA with
+//BEGIN_RES/END_RES around it in the pdbqt context
+static void convertFlexResidue(OBMol& mol, non_rigid_parsed& nr, context& c)
+{
+	DeleteHydrogens(mol);
+	mol.SetAutomaticFormalCharge(false);
+	if (mol.NumAtoms() == 0)
+		return;
+
+	vector<vector<int> > rigid_fragments;
+	map<unsigned int, obbranch> tree;
+	vector<int> norotate;
+	unsigned rootatom = 1; //CA
+	FindFragments(mol, rigid_fragments, rootatom, norotate);
+	unsigned torsdof = rigid_fragments.size() - 1;
+
+	unsigned int root_piece = 0;
+	for (unsigned j = 0; j < rigid_fragments.size(); j++)
+	{
+		if (IsIn((rigid_fragments[j]), rootatom))
+		{
+			root_piece = j;
+			break;
+		}
+	}
+	ConstructTree(tree, rigid_fragments, root_piece, mol, true);
+
+	char buffer[BUFF_SIZE];
+	OBResidue *res = mol.GetResidue(0);
+	if (res)
+		snprintf(buffer, BUFF_SIZE, "%-3s %c%4d", res->GetName().c_str(),
+				res->GetChain(), res->GetNum());
+	else
+		snprintf(buffer, BUFF_SIZE, "UNK  %4d", 1);
+	string resid(buffer);
+
+	parsing_struct p;
+	add_pdbqt_context(c, "BEGIN_RES " + resid);
+	OutputTree(mol, c, p, tree, torsdof, true);
+	add_pdbqt_context(c, "END_RES " + resid);
+	postprocess_residue(nr, p, c);
+}
+
+model convertReceptor(OBMol& rigidmol, vector<OBMol>& flex)
+{
+	rigid r;
+	convertRigid(rigidmol, r);
+
+	pdbqt_initializer tmp;
+	tmp.initialize_from_rigid(r);
+	if (flex.size() > 0)
+	{
+		non_rigid_parsed nrp;
+		context c;
+		for (unsigned i = 0, n = flex.size(); i < n; i++)
+			convertFlexResidue(flex[i], nrp, c);
+		tmp.initialize_from_nrp(nrp, c, false);
+		tmp.initialize(nrp.mobility_matrix());
+	}
+	else
+	{
+		distance_type_matrix mobility_matrix;
+		tmp.initialize(mobility_matrix);
+	}
+	return tmp.m;
 }
 
 } //namespace SminaConverter
@@ -22,14 +22,19 @@ namespace SminaConverter
 	//text output
 	void convertText(OpenBabel::OBMol& mol, std::ostream& out, int rootatom, const std::vector<int>& norotate);
 	void convertText(OpenBabel::OBMol& mol, std::ostream& out);
-	//binary output
-	void convertBinary(OpenBabel::OBMol& mol, std::ostream& out, int rootatom, const std::vector<int>& norotate);
-	void convertBinary(OpenBabel::OBMol& mol, std::ostream& out);
+	//binary output, one gzip member per molecule; return numtors
+	unsigned convertBinary(OpenBabel::OBMol& mol, std::ostream& out, int rootatom, const std::vector<int>& norotate);
+	unsigned convertBinary(OpenBabel::OBMol& mol, std::ostream& out);
 
 	//convert obmol to smina parsing struct and context; return numtors
 	unsigned convertParsing(OpenBabel::OBMol& mol, parsing_struct& p, context& c, int rootatom, const std::vector<int>& norotate, bool addH=true);
 	unsigned convertParsing(OpenBabel::OBMol& mol, parsing_struct& p, context& c, bool addH=true);
 
+	//convert a receptor straight to a model, the same as parsing the pdbqt
+	//OpenBabel would write for it except for the rounding; flex has a molecule
+	//for each flexible residue (see FlexInfo::extractFlex)
+	model convertReceptor(OpenBabel::OBMol& rigid, std::vector<OpenBabel::OBMol>& flex);
+
 	//class for efficiently converting multi-conformer molecule
 	class MCMolConverter
 	{
@@ -72,6 +72,7 @@ public:
 	}
 	T&       operator()(sz i, sz j, sz k)       { return m_data[i + m_i*(j + m_j*k)]; }
 	const T& operator()(sz i, sz j, sz k) const { return m_data[i + m_i*(j + m_j*k)]; }
+	const T* flat() const { return m_data.empty() ? NULL : &m_data[0]; } // element (i, j, k) at i + dim0*(j + dim1*k)
 };
 
 #endif
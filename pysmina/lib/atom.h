@@ -70,6 +70,8 @@ private:
 		ar & boost::serialization::base_object<atom_base>(*this);
 		ar & coords;
 		//ar & bonds; //not set until after parsing
+		if(exact_archive<Archive>::value)
+			ar & bonds;
 	}
 };
 
@@ -35,6 +35,11 @@ private:
 	template<class Archive> 
 	void serialize(Archive& ar, const unsigned version) {
 		ar & boost::serialization::base_object<atom_type>(*this);
+		if(exact_archive<Archive>::value)
+		{
+			ar & charge;
+			return;
+		}
 		float c  = charge;
 		ar & c;
 		charge = c; //store as floats, has side effect of rounding, don't care
@@ -13,13 +13,15 @@
 
 class builtin_scoring
 {
+	//terms are constructed directly, without parsing their names
+	typedef term* (*term_maker)();
 	struct singleterm
 	{
-		const char* term;
+		term_maker make;
 		double weight;
 
-		singleterm(): term(NULL), weight(0) {}
-		singleterm(const char* t, double w): term(t), weight(w) {}
+		singleterm(): make(NULL), weight(0) {}
+		singleterm(term_maker m, double w): make(m), weight(w) {}
 	};
 
 	//map from names to sets of terms
@@ -29,9 +31,9 @@ class builtin_scoring
 	funcmap functions;
 	datamap atomdata;
 
-	void add(const std::string& name, const char *term, double w)
+	void add(const std::string& name, term_maker make, double w)
 	{
-		functions[name].push_back(singleterm(term,w));
+		functions[name].push_back(singleterm(make,w));
 	}
 
 	void addparams(const std::string& name, const smina_atom_type::info* data)
@@ -52,7 +54,7 @@ public:
 		std::vector<singleterm>& terms = functions[name];
 		for(unsigned i = 0, n = terms.size(); i < n; i++)
 		{
-			t.add(terms[i].term, terms[i].weight);
+			t.add(terms[i].make(), terms[i].weight);
 		}
 
 		if(atomdata.count(name))
@@ -44,24 +44,59 @@ typedef boost::archive::text_oarchive oarchive;
 cache::cache(const std::string& scoring_function_version_, const grid_dims& gd_,
 		fl slope_) :
 		scoring_function_version(scoring_function_version_), gd(gd_), slope(
-				slope_), grids(num_atom_types())
+				slope_), grids(num_atom_types()), grid_of(num_atom_types())
 {
+	VINA_FOR_IN(t, grid_of)
+		grid_of[t] = t;
+}
+
+//grid lookups go a block of atoms of one type at a time: coordinates and
+//charges are copied into arrays, located and interpolated on that type's
+//grid (and charge grid) in loops over the block; m's own grouping is used
+//when it is current
+const type_groups& cache::groups_of(const model& m, type_groups& tmp)
+{
+	if (m.grid_groups.current(m.atoms.size()))
+		return m.grid_groups;
+	tmp.build(m.atoms, m.num_movable_atoms());
+	return tmp;
+}
+
+//fills coords and charges for atoms idx[0..n)
+void cache::gather_block(const model& m, const sz* idx, sz n,
+		fl coords[3][grid::block_size], fl* charges)
+{
+	VINA_FOR(j, n)
+	{
+		const vec& a = m.coords[idx[j]];
+		coords[0][j] = a[0];
+		coords[1][j] = a[1];
+		coords[2][j] = a[2];
+		charges[j] = m.atoms[idx[j]].charge;
+	}
 }
 
 fl cache::eval(const model& m, fl v) const
 		{ // needs m.coords
 	fl e = 0;
-	sz nat = num_atom_types();
+	type_groups tmp;
+	const type_groups& groups = groups_of(m, tmp);
+	fl coords[3][grid::block_size];
+	const fl* const axes[3] = { coords[0], coords[1], coords[2] };
+	fl charges[grid::block_size];
+	grid::cell_block cells;
 
-	VINA_FOR(i, m.num_movable_atoms())
+	VINA_FOR_IN(k, groups.types)
 	{
-		const atom& a = m.atoms[i];
-		smt t = a.get();
-		if (t >= nat || is_hydrogen(t))
-			continue;
-		const grid& g = grids[t];
+		const grid& g = grids[grid_of[groups.types[k]]];
 		assert(g.initialized());
-		e += g.evaluate(a, m.coords[i], slope, v);
+		for (sz start = groups.starts[k]; start < groups.starts[k + 1]; start += grid::block_size)
+		{
+			sz n = (std::min)(grid::block_size, groups.starts[k + 1] - start);
+			gather_block(m, &groups.atoms[start], n, coords, charges);
+			g.locate(axes, n, slope, cells);
+			e += g.evaluate(cells, charges, slope, v, NULL);
+		}
 	}
 	return e;
 }
@@ -69,23 +104,31 @@ fl cache::eval(const model& m, fl v) const
 fl cache::eval_deriv(model& m, fl v, const grid& user_grid) const
 		{ // needs m.coords, sets m.minus_forces
 	fl e = 0;
-	sz nat = num_atom_types();
+	type_groups tmp;
+	const type_groups& groups = groups_of(m, tmp);
+	fl coords[3][grid::block_size];
+	const fl* const axes[3] = { coords[0], coords[1], coords[2] };
+	fl charges[grid::block_size];
+	vec derivs[grid::block_size];
+	grid::cell_block cells;
 
-	VINA_FOR(i, m.num_movable_atoms())
+	VINA_FOR_IN(k, groups.types)
 	{
-		const atom& a = m.atoms[i];
-		smt t = a.get();
-		if (t >= nat || is_hydrogen(t))
+		const grid& g = grids[grid_of[groups.types[k]]];
+		assert(g.initialized());
+		for (sz start = groups.starts[k]; start < groups.starts[k + 1]; start += grid::block_size)
 		{
-			m.minus_forces[i].assign(0);
-			continue;
+			sz n = (std::min)(grid::block_size, groups.starts[k + 1] - start);
+			const sz* idx = &groups.atoms[start];
+			gather_block(m, idx, n, coords, charges);
+			g.locate(axes, n, slope, cells);
+			e += g.evaluate(cells, charges, slope, v, derivs);
+			VINA_FOR(j, n)
+				m.minus_forces[idx[j]] = derivs[j];
 		}
-		const grid& g = grids[t];
-		assert(g.initialized());
-		vec deriv;
-		e += g.evaluate(a, m.coords[i], slope, v, &deriv);
-		m.minus_forces[i] = deriv;
 	}
+	VINA_FOR_IN(j, groups.skipped)
+		m.minus_forces[groups.skipped[j]].assign(0);
 	return e;
 }
 
@@ -96,6 +139,7 @@ void cache::save(Archive& ar, const unsigned version) const
 	ar & scoring_function_version;
 	ar & gd;
 	ar & grids;
+	ar & grid_of;
 }
 
 template<class Archive>
@@ -111,6 +155,58 @@ void cache::load(Archive& ar, const unsigned version)
 		throw grid_dims_mismatch();
 
 	ar & grids;
+	ar & grid_of;
+}
+
+void cache::probe(const atomv& receptor, const szv& possibilities,
+		const vec& probe_coords, const precalculate& p,
+		const std::vector<smt>& needed, flv& affinities, flv& chargeaffinities)
+{
+	bool haschargeterms = !chargeaffinities.empty();
+	const fl cutoff_sqr = p.cutoff_sqr();
+	sz nat = num_atom_types();
+
+	std::fill(affinities.begin(), affinities.end(), 0);
+	std::fill(chargeaffinities.begin(), chargeaffinities.end(), 0);
+	VINA_FOR_IN(possibilities_i, possibilities)
+	{
+		const sz i = possibilities[possibilities_i];
+		const atom& a = receptor[i];
+		const smt t1 = a.get();
+		const fl r2 = vec_distance_sqr(a.coords, probe_coords);
+		if (r2 <= cutoff_sqr)
+		{
+			VINA_FOR_IN(j, needed)
+			{
+				const smt t2 = needed[j];
+				assert(t2 < nat);
+				//t1 is the receptor atom, a
+				//t2 is type from the ligand, not corresponding to any
+				//particular atom
+				result_components val = p.eval_fast(t1, t2, r2);
+				if (haschargeterms)
+				{
+					//affinities contains the terms that are independent of
+					//the ligand atom charge
+
+					affinities[j] +=
+							val[result_components::TypeDependentOnly]
+									+
+									val[result_components::AbsAChargeDependent]
+											* fabs(a.charge);
+					//this component must be multiplied by the ligand atom charge
+					chargeaffinities[j] +=
+							val[result_components::AbsBChargeDependent] +
+							val[result_components::ABChargeDependent]*a.charge; //not abs value
+				}
+				else
+				{
+					affinities[j] +=
+							val[result_components::TypeDependentOnly];
+				}
+			}
+		}
+	}
 }
 
 void cache::populate(const model& m, const precalculate& p,
@@ -119,10 +215,43 @@ void cache::populate(const model& m, const precalculate& p,
 	std::vector<smt> needed;
 	bool haschargeterms = p.has_components();
 
+	//grid values only depend on how a type interacts with the receptor's types
+	std::vector<smt> receptor_types;
+	VINA_FOR_IN(i, m.grid_atoms)
+	{
+		smt t = m.grid_atoms[i].get();
+		if (t < num_atom_types() && !has(receptor_types, t))
+			receptor_types.push_back(t);
+	}
+
 	VINA_FOR_IN(i, atom_types_needed)
 	{
 		smt t = atom_types_needed[i];
-		if (!grids[t].initialized())
+		if (grids[grid_of[t]].initialized())
+			continue;
+		//share the grid of an equivalent type, existing or about to be built
+		grid_of[t] = t;
+		VINA_FOR_IN(j, grids)
+		{
+			if (j != t && grid_of[j] == j && grids[j].initialized()
+					&& p.equivalent_types(t, smt(j), receptor_types))
+			{
+				grid_of[t] = j;
+				break;
+			}
+		}
+		if (grid_of[t] == t)
+		{
+			VINA_FOR_IN(j, needed)
+			{
+				if (p.equivalent_types(t, needed[j], receptor_types))
+				{
+					grid_of[t] = needed[j];
+					break;
+				}
+			}
+		}
+		if (grid_of[t] == t)
 		{
 			needed.push_back(t);
 			grids[t].init(gd, haschargeterms);
@@ -150,50 +279,11 @@ void cache::populate(const model& m, const precalculate& p,
 		{
 			VINA_FOR(z, g.data.dim2())
 			{
-				std::fill(affinities.begin(), affinities.end(), 0);
-				std::fill(chargeaffinities.begin(), chargeaffinities.end(), 0);
 				vec probe_coords;
 				probe_coords = g.index_to_argument(x, y, z);
 				const szv& possibilities = ig.possibilities(probe_coords);
-				VINA_FOR_IN(possibilities_i, possibilities)
-				{
-					const sz i = possibilities[possibilities_i];
-					const atom& a = m.grid_atoms[i];
-					const smt t1 = a.get();
-					const fl r2 = vec_distance_sqr(a.coords, probe_coords);
-					if (r2 <= cutoff_sqr)
-					{
-						VINA_FOR_IN(j, needed)
-						{
-							const smt t2 = needed[j];
-							assert(t2 < nat);
-							//t1 is the receptor atom, a
-							//t2 is type from the ligand, not corresponding to any
-							//particular atom
-							result_components val = p.eval_fast(t1, t2, r2);
-							if (haschargeterms)
-							{
-								//affinities contains the terms that are independent of
-								//the ligand atom charge
-
-								affinities[j] +=
-										val[result_components::TypeDependentOnly]
-												+
-												val[result_components::AbsAChargeDependent]
-														* fabs(a.charge);
-								//this component must be multiplied by the ligand atom charge
-								chargeaffinities[j] +=
-										val[result_components::AbsBChargeDependent] +
-										val[result_components::ABChargeDependent]*a.charge; //not abs value
-							}
-							else
-							{
-								affinities[j] +=
-										val[result_components::TypeDependentOnly];
-							}
-						}
-					}
-				}
+				probe(m.grid_atoms, possibilities, probe_coords, p, needed,
+						affinities, chargeaffinities);
 				VINA_FOR_IN(j, needed)
 				{
 					sz t = needed[j];
@@ -40,12 +40,24 @@ struct cache : public igrid {
 	fl eval_deriv(      model& m, fl v, const grid& user_grid) const; // needs m.coords, sets m.minus_forces // clean up
 
 	void populate(const model& m, const precalculate& p, const std::vector<smt>& atom_types_needed, grid& user_grid, bool display_progress = true);
+	//receptor contribution at probe_coords for each type in needed, summed
+	//over the receptor atoms listed in possibilities; chargeaffinities
+	//must be empty if p has no charge dependent terms
+	static void probe(const atomv& receptor, const szv& possibilities,
+			const vec& probe_coords, const precalculate& p,
+			const std::vector<smt>& needed, flv& affinities, flv& chargeaffinities);
+	//grid of atom type t, NULL if it hasn't been populated
+	const grid* type_grid(smt t) const { return (t < grids.size() && grids[grid_of[t]].initialized()) ? &grids[grid_of[t]] : NULL; }
 private:
 	std::string scoring_function_version;
 	atomv atoms; // for verification
 	grid_dims gd;
 	fl slope; // does not get (de-)serialized
 	std::vector<grid> grids;
+	szv grid_of; //types that score identically share the grid of one of them
+	static const type_groups& groups_of(const model& m, type_groups& tmp);
+	static void gather_block(const model& m, const sz* idx, sz n,
+			fl coords[3][grid::block_size], fl* charges);
 	friend class boost::serialization::access;
 	template<class Archive>
 	void save(Archive& ar, const unsigned version) const;
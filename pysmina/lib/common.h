@@ -35,10 +35,12 @@
 #include <iomanip> // to_string
 #include <sstream> // to_string
 #include <string> // probably included by the above anyway, common anyway
+#include <string_view> // starts_with
 
 #include <boost/serialization/vector.hpp> // can't come before the above two - wart fixed in upcoming Boost versions
 #include <boost/serialization/base_object.hpp> // movable_atom needs it - (derived from atom)
 #include <boost/filesystem/path.hpp> // typedef'ed
+#include <boost/type_traits/integral_constant.hpp> // exact_archive
 
 #include <openbabel/atom.h>
 #include <openbabel/mol.h>
@@ -50,6 +52,13 @@
 
 typedef double fl;
 
+//true for archives that have to round trip exactly (see prepared_receptor.h);
+//others get coordinates and charges as floats, and no atom bonds
+template<class Archive>
+struct exact_archive : public boost::false_type
+{
+};
+
 
 //collection of parameters specifying how minimization should be done
 struct minimization_params
@@ -156,6 +165,11 @@ private:
 	void serialize(Archive& ar, const unsigned version) {
 		for(unsigned i = 0; i < 3; i++) //store as floats
 		{
+			if(exact_archive<Archive>::value)
+			{
+				ar & data[i];
+				continue;
+			}
 			float x = data[i];
 			ar & x;
 			data[i] = x;
@@ -390,7 +404,7 @@ void printnl(const T& x, std::ostream& out = std::cout) {
 	out << '\n';
 }
 
-inline bool starts_with(const std::string& str, const std::string& start) {
+inline bool starts_with(std::string_view str, std::string_view start) {
 	return str.size() >= start.size() && str.substr(0, start.size()) == start;
 }
 
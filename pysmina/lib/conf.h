@@ -409,7 +409,8 @@ struct output_type {
 	conf c;
 	fl e;
 	vecv coords;
-	output_type(const conf& c_, fl e_) : c(c_), e(e_) {}
+	vec centroid; // of coords; set by add_to_output_container, NaN if unknown
+	output_type(const conf& c_, fl e_) : c(c_), e(e_), centroid(not_a_num, not_a_num, not_a_num) {}
 };
 
 typedef boost::ptr_vector<output_type> output_container;
@@ -24,6 +24,7 @@
 #define VINA_CONVERT_SUBSTRING_H
 
 #include <cctype> // for isspace
+#include <string_view>
 #include <boost/lexical_cast.hpp>
 #include "common.h"
 
@@ -47,7 +48,7 @@ T convert_substring(const std::string& str, sz i, sz j) { // indexes are 1-based
 	return tmp;
 }
 
-inline bool substring_is_blank(const std::string& str, sz i, sz j) { // indexes are 1-based, the substring should be non-null
+inline bool substring_is_blank(std::string_view str, sz i, sz j) { // indexes are 1-based, the substring should be non-null
 	if(i < 1 || i > j+1 || j > str.size()) throw bad_conversion();
 	VINA_RANGE(k, i-1, j)
 		if(!std::isspace(str[k]))
@@ -22,12 +22,50 @@
 
 #include "coords.h"
 
-fl rmsd_upper_bound(const vecv& a, const vecv& b) {
-	VINA_CHECK(a.size() == b.size());
+// sum of squared distances between corresponding atoms, giving up once it
+// exceeds limit.  One accumulator per axis keeps the inner loop free of
+// reassociation so the compiler can vectorize it; the limit is only checked
+// between blocks of 8 atoms
+static fl distance_sqr_sum(const vecv& a, const vecv& b, fl limit) {
+	const sz block = 8;
+	const sz n = a.size();
 	fl acc = 0;
+	sz i = 0;
+	while(i < n) {
+		const sz end = (std::min)(i + block, n);
+		fl acc0 = 0, acc1 = 0, acc2 = 0;
+		for(; i < end; ++i) {
+			acc0 += sqr(a[i][0] - b[i][0]);
+			acc1 += sqr(a[i][1] - b[i][1]);
+			acc2 += sqr(a[i][2] - b[i][2]);
+		}
+		acc += acc0 + acc1 + acc2;
+		if(acc > limit)
+			break;
+	}
+	return acc;
+}
+
+fl rmsd_upper_bound(const vecv& a, const vecv& b, fl cutoff) {
+	VINA_CHECK(a.size() == b.size());
+	if(a.empty())
+		return 0;
+	const fl limit = (cutoff < max_fl) ? sqr(cutoff) * a.size() : max_fl;
+	fl acc = distance_sqr_sum(a, b, limit);
+	return std::sqrt(acc / a.size());
+}
+
+fl rmsd_upper_bound(const vecv& a, const vecv& b) {
+	return rmsd_upper_bound(a, b, max_fl);
+}
+
+vec centroid(const vecv& a) {
+	vec tmp(0, 0, 0);
 	VINA_FOR_IN(i, a)
-		acc += vec_distance_sqr(a[i], b[i]);
-	return (a.size() > 0) ? std::sqrt(acc / a.size()) : 0;
+		tmp += a[i];
+	if(!a.empty())
+		tmp *= 1.0 / a.size();
+	return tmp;
 }
 
 std::pair<sz, fl> find_closest(const vecv& a, const output_container& b) {
@@ -40,19 +78,64 @@ std::pair<sz, fl> find_closest(const vecv& a, const output_container& b) {
 	return tmp;
 }
 
-void add_to_output_container(output_container& out, const output_type& t, fl min_rmsd, sz max_size) {
-	std::pair<sz, fl> closest_rmsd = find_closest(t.coords, out);
-	if(closest_rmsd.first < out.size() && closest_rmsd.second < min_rmsd) { // have a very similar one
-		if(t.e < out[closest_rmsd.first].e) { // the new one is better, apparently
-			out[closest_rmsd.first] = t; // FIXME? slow
-		}
+// closest pose in b that is within min_rmsd of a; (b.size(), max_fl) if none.
+// rmsd >= distance between centroids, so most poses are rejected without
+// looking at their coordinates
+static std::pair<sz, fl> find_similar(const vecv& a, const vec& a_centroid, const output_container& b, fl min_rmsd) {
+	std::pair<sz, fl> tmp(b.size(), max_fl);
+	const fl min_rmsd_sqr = sqr(min_rmsd);
+	VINA_FOR_IN(i, b) {
+		if(vec_distance_sqr(a_centroid, b[i].centroid) >= min_rmsd_sqr) // false for unknown (NaN) centroids
+			continue;
+		fl res = rmsd_upper_bound(a, b[i].coords, (std::min)(min_rmsd, tmp.second));
+		if(res < min_rmsd && res < tmp.second)
+			tmp = std::pair<sz, fl>(i, res);
+	}
+	return tmp;
+}
+
+// element i of out has just improved; move it forward to keep out sorted
+static void restore_order(output_container& out, sz i) {
+	std::vector<void*>& v = out.base(); // pointers only, nothing is copied
+	sz pos = i;
+	while(pos > 0 && out[i].e < out[pos - 1].e)
+		--pos;
+	if(pos < i)
+		std::rotate(v.begin() + pos, v.begin() + i, v.begin() + i + 1);
+}
+
+// T is const output_type& or output_type&&; the pose is only copied if it is kept
+template<typename T>
+static void add_to_output_container_aux(output_container& out, T&& t, fl min_rmsd, sz max_size) {
+	const vec c = centroid(t.coords);
+	std::pair<sz, fl> closest_rmsd = find_similar(t.coords, c, out, min_rmsd);
+	sz i = out.size();
+	if(closest_rmsd.first < out.size()) { // have a very similar one
+		if(t.e >= out[closest_rmsd.first].e) // the old one is at least as good
+			return;
+		i = closest_rmsd.first;
+		out[i] = std::forward<T>(t);
 	}
 	else { // nothing similar
-		if(out.size() < max_size)
-			out.push_back(new output_type(t)); // the last one had the worst energy - replacing 
+		if(out.size() < max_size) {
+			out.push_back(new output_type(std::forward<T>(t)));
+			i = out.size() - 1;
+		}
+		else if(!out.empty() && t.e < out.back().e) { // the last one had the worst energy - replacing
+			i = out.size() - 1;
+			out[i] = std::forward<T>(t);
+		}
 		else
-			if(!out.empty() && t.e < out.back().e) // FIXME? - just changed
-				out.back() = t; // FIXME? slow
+			return;
 	}
-	out.sort();
+	out[i].centroid = c;
+	restore_order(out, i);
+}
+
+void add_to_output_container(output_container& out, const output_type& t, fl min_rmsd, sz max_size) {
+	add_to_output_container_aux(out, t, min_rmsd, max_size);
+}
+
+void add_to_output_container(output_container& out, output_type&& t, fl min_rmsd, sz max_size) {
+	add_to_output_container_aux(out, std::move(t), min_rmsd, max_size);
 }
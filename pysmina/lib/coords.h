@@ -27,8 +27,13 @@
 #include "atom.h" // for atomv
 
 fl rmsd_upper_bound(const vecv& a, const vecv& b);
+// exact if the result is below cutoff; otherwise stops early and returns something >= cutoff
+fl rmsd_upper_bound(const vecv& a, const vecv& b, fl cutoff);
+vec centroid(const vecv& a);
 std::pair<sz, fl> find_closest(const vecv& a, const output_container& b);
+// out stays sorted by energy and free of poses closer than min_rmsd, keeping the better one
 void add_to_output_container(output_container& out, const output_type& t, fl min_rmsd, sz max_size);
+void add_to_output_container(output_container& out, output_type&& t, fl min_rmsd, sz max_size);
 
 
 #endif
@@ -23,9 +23,7 @@ void custom_terms::add(const std::string& name, fl weight)
 			term *t = creators[i]->createFrom(name);
 			if(t != NULL)
 			{
-				TermKind kind = t->kind();
-				term_weights[(unsigned)kind].push_back(weight * custom_terms::scaling_factor);
-				terms::add(1, t);
+				add_term(t, weight, name);
 				return;
 			}
 		}
@@ -37,6 +35,24 @@ void custom_terms::add(const std::string& name, fl weight)
 	throw scoring_function_error(name, "Unknown term ");
 }
 
+//add an already constructed term, taking ownership
+void custom_terms::add(term* t, fl weight)
+{
+	add_term(t, weight, t->name);
+}
+
+void custom_terms::add_term(term* t, fl weight, const std::string& desc)
+{
+	TermKind kind = t->kind();
+	term_weights[(unsigned)kind].push_back(weight * custom_terms::scaling_factor);
+	terms::add(1, t);
+
+	//exact weights, the names of parsed terms are rounded
+	std::stringstream str;
+	str << std::hexfloat << weight * custom_terms::scaling_factor << " " << desc << "\n";
+	spec += str.str();
+}
+
 //return weights in correct order
 flv custom_terms::weights() const
 {
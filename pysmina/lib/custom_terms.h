@@ -24,10 +24,16 @@ private:
 	flv term_weights[LastTermKind];
 	term_creators creators;
 	fl scaling_factor;
+	std::string spec; //every term added, in order, with its weight
+
+	void add_term(term* t, fl weight, const std::string& desc);
 
 public:
 	custom_terms() { scaling_factor = 1; }
 	void add(const std::string& name, fl weight);
+	void add(term* t, fl weight);
+	//identifies the terms and weights, for reusing what was computed from them
+	const std::string& specification() const { return spec; }
 	flv weights() const;
 	void add_terms_from_file(std::istream& in);
 	void print(std::ostream& out) const;
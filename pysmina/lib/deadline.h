@@ -0,0 +1,41 @@
+/*
+ * deadline.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_DEADLINE_H
+#define SMINA_DEADLINE_H
+
+#include <chrono>
+#include "common.h"
+
+// A wall-clock point after which a search should wrap up.  Default
+// constructed deadlines never pass.  Cheap enough to poll every MC step.
+class deadline
+{
+	typedef std::chrono::steady_clock clock;
+	clock::time_point when;
+
+public:
+	deadline() : when(clock::time_point::max()) {}
+
+	// seconds <= 0 means no limit
+	static deadline after(fl seconds)
+	{
+		deadline ret;
+		if (seconds > 0)
+			ret.when = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<fl>(seconds));
+		return ret;
+	}
+
+	deadline earliest(const deadline& other) const
+	{
+		return other.when < when ? other : *this;
+	}
+
+	bool is_set() const { return when != clock::time_point::max(); }
+	bool passed() const { return is_set() && clock::now() >= when; }
+};
+
+#endif /* SMINA_DEADLINE_H */
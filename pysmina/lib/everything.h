@@ -58,6 +58,49 @@ inline fl smooth_div(fl x, fl y) {
 	return x / y;
 }
 
+//value and derivative with respect to x (or r) of common term shapes
+
+inline pr gaussian_deriv(fl x, fl width)
+{
+	fl g = gaussian(x, width);
+	return pr(g, -2 * x / sqr(width) * g);
+}
+
+//d*d for d <= 0, else 0
+inline pr quadratic_below_deriv(fl d)
+{
+	if (d > 0)
+		return pr(0, 0);
+	return pr(d * d, 2 * d);
+}
+
+//min(cap, 1/r^power)
+template<unsigned power>
+inline pr capped_inverse_power_deriv(fl cap, fl r)
+{
+	fl tmp = int_pow<power>(r);
+	if (tmp < epsilon_fl) //avoid divide by zero
+		return pr(cap, 0);
+	if (1 / tmp < cap)
+		return pr(1 / tmp, -fl(power) / (tmp * r));
+	return pr(cap, 0);
+}
+
+//min(cap, c_i/r^i + c_j/r^j)
+template<unsigned i, unsigned j>
+inline pr capped_lj_deriv(fl c_i, fl c_j, fl cap, fl r)
+{
+	fl r_i = int_pow<i>(r);
+	fl r_j = int_pow<j>(r);
+	if (r_i > epsilon_fl && r_j > epsilon_fl)
+	{
+		fl e = c_i / r_i + c_j / r_j;
+		if (e < cap)
+			return pr(e, -(i * c_i / r_i + j * c_j / r_j) / r);
+	}
+	return pr(cap, 0);
+}
+
 
 // distance_additive terms
 
@@ -71,7 +114,6 @@ struct electrostatic: public charge_dependent
 	{
 		name = std::string("electrostatic(i=") + to_string(power) + ",_^="
 				+ to_string(cap) + ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("electrostatic\\(i=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 
 	}
 
@@ -86,8 +128,23 @@ struct electrostatic: public charge_dependent
 		return comp;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	component_pair eval_components_deriv(smt t1, smt t2, fl r) const
+	{
+		component_pair ret;
+		pr e = capped_inverse_power_deriv<power>(cap, r);
+		ret.first[result_components::ABChargeDependent] = e.first;
+		ret.second[result_components::ABChargeDependent] = e.second;
+		return ret;
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("electrostatic\\(i=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -116,7 +173,6 @@ struct ad4_solvation: public charge_dependent
 				+ to_string(desolvation_sigma) + ",_s/q="
 				+ to_string(solvation_q) +
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("ad4_solvation\\(d-sigma=(\\S+),_s/q=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 
 	}
 
@@ -141,8 +197,30 @@ struct ad4_solvation: public charge_dependent
 		return ret;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	component_pair eval_components_deriv(smt t1, smt t2, fl r) const
+	{
+		component_pair ret;
+		ret.first = eval_components(t1, t2, r);
+
+		fl volume1 = ad_volume(t1);
+		fl volume2 = ad_volume(t2);
+		fl distfactor = std::exp(-sqr(r/(2*desolvation_sigma)));
+		fl d = -r / (2 * sqr(desolvation_sigma)) * distfactor;
+
+		ret.second[result_components::TypeDependentOnly] = (solvation_parameter(t1)*volume2 + solvation_parameter(t2)*volume1)*d;
+		ret.second[result_components::AbsAChargeDependent] = solvation_q*volume2*d;
+		ret.second[result_components::AbsBChargeDependent] = solvation_q*volume1*d;
+		return ret;
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("ad4_solvation\\(d-sigma=(\\S+),_s/q=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -167,7 +245,6 @@ struct gauss: public charge_independent
 	{
 		name = std::string("gauss(o=") + to_string(offset) + ",_w="
 				+ to_string(width) + ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("gauss\\(o=(\\S+),_w=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 
 	}
 	fl eval(smt t1, smt t2, fl r) const
@@ -175,8 +252,19 @@ struct gauss: public charge_independent
 		return gaussian(r - (optimal_distance(t1, t2) + offset), width);
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		return gaussian_deriv(r - (optimal_distance(t1, t2) + offset), width);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("gauss\\(o=(\\S+),_w=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -195,7 +283,6 @@ struct repulsion: public charge_independent
 	{
 		name = std::string("repulsion(o=") + to_string(offset) + ",_c="
 				+ to_string(cutoff) + ")";
-		rexpr.assign("repulsion\\(o=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 
 	}
 	fl eval(smt t1, smt t2, fl r) const
@@ -206,8 +293,19 @@ struct repulsion: public charge_independent
 		return d * d;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		return quadratic_below_deriv(r - (optimal_distance(t1, t2) + offset));
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("repulsion\\(o=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -236,6 +334,15 @@ inline fl slope_step(fl x_bad, fl x_good, fl x)
 	return (x - x_bad) / (x_good - x_bad);
 }
 
+//value and derivative of slope_step
+inline pr slope_step_deriv(fl x_bad, fl x_good, fl x)
+{
+	fl e = slope_step(x_bad, x_good, x);
+	if (e == 0 || e == 1)
+		return pr(e, 0);
+	return pr(e, 1 / (x_good - x_bad));
+}
+
 struct hydrophobic: public charge_independent
 {
 	fl good;
@@ -245,7 +352,6 @@ struct hydrophobic: public charge_independent
 	{
 		name = "hydrophobic(g=" + to_string(good) + ",_b=" + to_string(bad)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("hydrophobic\\(g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt t1, smt t2, fl r) const
 	{
@@ -255,8 +361,21 @@ struct hydrophobic: public charge_independent
 			return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (xs_is_hydrophobic(t1) && xs_is_hydrophobic(t2))
+			return slope_step_deriv(bad, good, r - optimal_distance(t1, t2));
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("hydrophobic\\(g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -276,7 +395,6 @@ struct non_hydrophobic: public charge_independent
 	{
 		name = "non_hydrophobic(g=" + to_string(good) + ",_b=" + to_string(bad)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("non_hydrophobic\\(g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 
 	}
 	fl eval(smt t1, smt t2, fl r) const
@@ -287,8 +405,21 @@ struct non_hydrophobic: public charge_independent
 			return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (!xs_is_hydrophobic(t1) && !xs_is_hydrophobic(t2))
+			return slope_step_deriv(bad, good, r - optimal_distance(t1, t2));
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("non_hydrophobic\\(g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -319,7 +450,6 @@ struct vdw: public charge_independent
 		name = "vdw(i=" + to_string(i) + ",_j=" + to_string(j) + ",_s="
 				+ to_string(smoothing) + ",_^=" + to_string(cap) + ",_c="
 				+ to_string(cutoff) + ")";
-		rexpr.assign("vdw\\(i=(\\S+),_j=(\\S+),_s=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 
 	}
 	fl eval(smt t1, smt t2, fl r) const
@@ -344,8 +474,36 @@ struct vdw: public charge_independent
 			return cap;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		fl d0 = optimal_distance(t1, t2);
+		fl depth = 1;
+		fl c_i = 0;
+		fl c_j = 0;
+		find_vdw_coefficients<i, j>(d0, depth, c_i, c_j);
+		fl dr = 1; //d(smoothed r)/dr
+		if (r > d0 + smoothing)
+			r -= smoothing;
+		else if (r < d0 - smoothing)
+			r += smoothing;
+		else
+		{
+			r = d0;
+			dr = 0;
+		}
+		pr ret = capped_lj_deriv<i, j>(c_i, c_j, cap, r);
+		ret.second *= dr;
+		return ret;
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("vdw\\(i=(\\S+),_j=(\\S+),_s=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -374,7 +532,6 @@ struct non_dir_h_bond_lj: public charge_independent
 		name = std::string("non_dir_h_bond_lj(o=") + to_string(offset)
 				+ ",_^=" + to_string(cap)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("non_dir_h_bond_lj\\(o=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt t1, smt t2, fl r) const
 	{
@@ -396,8 +553,28 @@ struct non_dir_h_bond_lj: public charge_independent
 		return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (xs_h_bond_possible(t1, t2))
+		{
+			fl d0 = optimal_distance(t1, t2)+offset;
+			fl depth = 5;
+			fl c_i = 0;
+			fl c_j = 0;
+			find_vdw_coefficients<10, 12>(d0, depth, c_i, c_j);
+			return capped_lj_deriv<10, 12>(c_i, c_j, cap, r);
+		}
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("non_dir_h_bond_lj\\(o=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -417,7 +594,6 @@ struct non_dir_anti_h_bond_quadratic: public charge_independent
 	{
 		name = std::string("non_dir_anti_h_bond_quadratic(o=") + to_string(offset)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("non_dir_anti_h_bond_quadratic\\(o=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt t1, smt t2, fl r) const
 	{
@@ -431,8 +607,21 @@ struct non_dir_anti_h_bond_quadratic: public charge_independent
 		return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (xs_anti_h_bond(t1, t2))
+			return quadratic_below_deriv(r - (optimal_distance(t1, t2) + offset));
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("non_dir_anti_h_bond_quadratic\\(o=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -451,7 +640,6 @@ struct donor_donor_quadratic: public charge_independent
 	{
 		name = std::string("donor_donor_quadratic(o=") + to_string(offset)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("donor_donor_quadratic\\(o=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt t1, smt t2, fl r) const
 	{
@@ -465,8 +653,21 @@ struct donor_donor_quadratic: public charge_independent
 		return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (xs_is_donor(t1) && xs_is_donor(t2))
+			return quadratic_below_deriv(r - (optimal_distance(t1, t2) + offset));
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("donor_donor_quadratic\\(o=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -485,7 +686,6 @@ struct acceptor_acceptor_quadratic: public charge_independent
 	{
 		name = std::string("acceptor_acceptor_quadratic(o=") + to_string(offset)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("acceptor_acceptor_quadratic\\(o=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt t1, smt t2, fl r) const
 	{
@@ -498,8 +698,21 @@ struct acceptor_acceptor_quadratic: public charge_independent
 		}
 		return 0;
 	}
+
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (xs_is_acceptor(t1) && xs_is_acceptor(t2))
+			return quadratic_below_deriv(r - (optimal_distance(t1, t2) + offset));
+		return pr(0, 0);
+	}
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("acceptor_acceptor_quadratic\\(o=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -519,7 +732,6 @@ struct non_dir_h_bond: public charge_independent
 	{
 		name = std::string("non_dir_h_bond(g=") + to_string(good) + ",_b="
 				+ to_string(bad) + ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("non_dir_h_bond\\(g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt t1, smt t2, fl r) const
 	{
@@ -528,8 +740,21 @@ struct non_dir_h_bond: public charge_independent
 		return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		if (xs_h_bond_possible(t1, t2))
+			return slope_step_deriv(bad, good, r - optimal_distance(t1, t2));
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("non_dir_h_bond\\(g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 
@@ -580,7 +805,6 @@ struct atom_type_inverse_power: public atom_type_base
 		name = std::string("atom_type_inverse_power(t1=")+name1+",t2="+name2+",i="
 				+ to_string(power) +",_^="+to_string(cap)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("atom_type_inverse_power\\(t1=(\\S+),t2=(\\S+),i=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt T1, smt T2, fl r) const
 	{
@@ -595,8 +819,21 @@ struct atom_type_inverse_power: public atom_type_base
 		return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt T1, smt T2, fl r) const
+	{
+		if (types_match(T1, T2))
+			return capped_inverse_power_deriv<power>(cap, r);
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("atom_type_inverse_power\\(t1=(\\S+),t2=(\\S+),i=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 		std::string n1 = match[1];
@@ -626,7 +863,6 @@ struct atom_type_gaussian: public atom_type_base
 		name = std::string("atom_type_gaussian(t1="+name1+",t2="+name2+",o=")
 				+ to_string(offset) +",_w="+to_string(width)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("atom_type_gaussian\\(t1=(\\S+),t2=(\\S+),o=(\\S+),_w=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt T1, smt T2, fl r) const
 	{
@@ -637,8 +873,21 @@ struct atom_type_gaussian: public atom_type_base
 		return 0;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt T1, smt T2, fl r) const
+	{
+		if (types_match(T1, T2))
+			return gaussian_deriv(r - (optimal_distance(t1, t2) + offset), width);
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("atom_type_gaussian\\(t1=(\\S+),t2=(\\S+),o=(\\S+),_w=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 		std::string n1 = match[1];
@@ -660,7 +909,6 @@ struct atom_type_lennard_jones: public atom_type_base
 	{
 		name = std::string("atom_type_lennard_jones(t1="+name1+",t2="+name2+",o=")
 				+ to_string(optimal_distance)+",_^="+to_string(cap)+",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("atom_type_lennard_jones\\(t1=(\\S+),t2=(\\S+),o=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt T1, smt T2, fl r) const
 	{
@@ -678,8 +926,22 @@ struct atom_type_lennard_jones: public atom_type_base
 			return cap;
 	}
 
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt T1, smt T2, fl r) const
+	{
+		fl c_i = 0;
+		fl c_j = 0;
+		find_vdw_coefficients<6, 12>(optimal_distance, 1, c_i, c_j);
+		return capped_lj_deriv<6, 12>(c_i, c_j, cap, r);
+	}
+
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("atom_type_lennard_jones\\(t1=(\\S+),t2=(\\S+),o=(\\S+),_\\^=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 		std::string n1 = match[1];
@@ -701,7 +963,6 @@ struct atom_type_linear: public atom_type_base
 		name = std::string("atom_type_linear(t1="+name1+",t2="+name2+",g=")
 				+ to_string(good) +",_b="+to_string(bad)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("atom_type_linear\\(t1=(\\S+),t2=(\\S+),g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt T1, smt T2, fl r) const
 	{
@@ -711,8 +972,21 @@ struct atom_type_linear: public atom_type_base
 		}
 		return 0;
 	}
+
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt T1, smt T2, fl r) const
+	{
+		if (types_match(T1, T2))
+			return slope_step_deriv(bad, good, r - optimal_distance(t1, t2));
+		return pr(0, 0);
+	}
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("atom_type_linear\\(t1=(\\S+),t2=(\\S+),g=(\\S+),_b=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 		std::string n1 = match[1];
@@ -734,7 +1008,6 @@ struct atom_type_quadratic: public atom_type_base
 	{
 		name = std::string("atom_type_quadratic(t1="+name1+",t2="+name2+",o=") + to_string(offset)
 				+ ",_c=" + to_string(cutoff) + ")";
-		rexpr.assign("atom_type_quadratic\\(t1=(\\S+),t2=(\\S+),o=(\\S+),_c=(\\S+)\\)",boost::regex::perl);
 	}
 	fl eval(smt T1, smt T2, fl r) const
 	{
@@ -747,8 +1020,21 @@ struct atom_type_quadratic: public atom_type_base
 		}
 		return 0;
 	}
+
+	bool has_deriv() const
+	{
+		return true;
+	}
+	pr eval_deriv(smt T1, smt T2, fl r) const
+	{
+		if (types_match(T1, T2))
+			return quadratic_below_deriv(r - (optimal_distance(t1, t2) + offset));
+		return pr(0, 0);
+	}
 	virtual term* createFrom(const std::string& desc) const {
 		boost::smatch match;
+		static const boost::regex rexpr("atom_type_quadratic\\(t1=(\\S+),t2=(\\S+),o=(\\S+),_c=(\\S+)\\)",
+				boost::regex::perl);
 		if(!regex_match(desc, match, rexpr))
 			return NULL;
 		std::string n1 = match[1];
@@ -773,7 +1059,6 @@ struct num_tors_add: public conf_independent
 	num_tors_add()
 	{
 		name = "num_tors_add";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -788,7 +1073,7 @@ struct num_tors_add: public conf_independent
 	}
 
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 
 		return new num_tors_add();
@@ -800,7 +1085,6 @@ struct num_tors_sqr: public conf_independent
 	num_tors_sqr()
 	{
 		name = "num_tors_sqr";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -816,7 +1100,7 @@ struct num_tors_sqr: public conf_independent
 	}
 
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_tors_sqr();
 	}
@@ -827,7 +1111,6 @@ struct num_tors_sqrt: public conf_independent
 	num_tors_sqrt()
 	{
 		name = "num_tors_sqrt";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -840,7 +1123,7 @@ struct num_tors_sqrt: public conf_independent
 		return x + w * std::sqrt(fl(in.num_tors)) / sqrt(5.0);
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_tors_sqrt();
 	}
@@ -851,7 +1134,6 @@ struct num_tors_div: public conf_independent
 	num_tors_div()
 	{
 		name = "num_tors_div";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -865,7 +1147,7 @@ struct num_tors_div: public conf_independent
 		return smooth_div(x, 1 + w * in.num_tors / 5.0);
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_tors_div();
 	}
@@ -877,7 +1159,6 @@ struct num_tors_div_simple: public conf_independent
 	num_tors_div_simple()
 	{
 		name = "num_tors_div_simple";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -891,7 +1172,7 @@ struct num_tors_div_simple: public conf_independent
 		return smooth_div(x, 1 + w * in.num_tors);
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_tors_div_simple();
 	}
@@ -903,7 +1184,6 @@ struct ligand_length: public conf_independent
 	ligand_length()
 	{
 		name = "ligand_length";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -916,7 +1196,7 @@ struct ligand_length: public conf_independent
 		return x + w * in.ligand_lengths_sum;
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new ligand_length();
 	}
@@ -927,7 +1207,6 @@ struct num_ligands: public conf_independent
 	num_ligands()
 	{
 		name = "num_ligands";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -940,7 +1219,7 @@ struct num_ligands: public conf_independent
 		return x + w * in.num_ligands;
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_ligands();
 	}
@@ -951,7 +1230,6 @@ struct num_heavy_atoms_div: public conf_independent
 	num_heavy_atoms_div()
 	{
 		name = "num_heavy_atoms_div";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -964,7 +1242,7 @@ struct num_heavy_atoms_div: public conf_independent
 		return smooth_div(x, 1 + w * in.num_heavy_atoms);
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_heavy_atoms_div();
 	}
@@ -975,7 +1253,6 @@ struct num_heavy_atoms: public conf_independent
 	num_heavy_atoms()
 	{
 		name = "num_heavy_atoms";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -988,7 +1265,7 @@ struct num_heavy_atoms: public conf_independent
 		return x + w * in.num_heavy_atoms;
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_heavy_atoms();
 	}
@@ -999,7 +1276,6 @@ struct num_hydrophobic_atoms: public conf_independent
 	num_hydrophobic_atoms()
 	{
 		name = "num_hydrophobic_atoms";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -1012,7 +1288,7 @@ struct num_hydrophobic_atoms: public conf_independent
 		return x + w * in.num_hydrophobic_atoms;
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new num_hydrophobic_atoms();
 	}
@@ -1023,7 +1299,6 @@ struct constant_term: public conf_independent
 	constant_term()
 	{
 		name = "constant_term";
-		rexpr.assign(name);
 	}
 	sz size() const
 	{
@@ -1036,7 +1311,7 @@ struct constant_term: public conf_independent
 		return x + w;
 	}
 	virtual term* createFrom(const std::string& desc) const {
-		if(!regex_match(desc, rexpr))
+		if(desc != name)
 			return NULL;
 		return new constant_term();
 	}
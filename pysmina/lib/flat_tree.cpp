@@ -0,0 +1,281 @@
+/*
+ * flat_tree.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "flat_tree.h"
+
+void flat_tree::clear()
+{
+	bodies.clear();
+	num_ligands = 0;
+	built_for = max_sz;
+	parent.clear();
+	begin.clear();
+	end.clear();
+	torsion.clear();
+	relative_origin.clear();
+	relative_axis.clear();
+	child_start.clear();
+	child_list.clear();
+	heavy_start.clear();
+	heavy_list.clear();
+	hydrogen_start.clear();
+	hydrogen_list.clear();
+	origin.clear();
+	axis.clear();
+	orientation_q.clear();
+	orientation_m.clear();
+}
+
+sz flat_tree::add_frame(const atom_frame& f, sz parent_)
+{
+	sz k = parent.size();
+	parent.push_back(parent_);
+	begin.push_back(f.begin);
+	end.push_back(f.end);
+	torsion.push_back(max_sz);
+	relative_origin.push_back(zero_vec);
+	relative_axis.push_back(zero_vec);
+	origin.push_back(f.origin);
+	axis.push_back(zero_vec);
+	orientation_q.push_back(f.orientation_q);
+	orientation_m.push_back(f.orientation_m);
+	return k;
+}
+
+//depth first, in the order tree::set_conf consumes torsions
+void flat_tree::add_branches(const branches& b, sz parent_, body& bd)
+{
+	VINA_FOR_IN(i, b)
+	{
+		const segment& s = b[i].node;
+		sz k = add_frame(s, parent_);
+		relative_origin[k] = s.relative_origin;
+		relative_axis[k] = s.relative_axis;
+		axis[k] = s.axis;
+		torsion[k] = k - bd.first - (bd.ligand ? 1 : 0);
+		add_branches(b[i].children, k, bd);
+	}
+}
+
+void flat_tree::add(const flexible_body& b)
+{
+	VINA_CHECK(bodies.size() == num_ligands); //ligands come first
+	body bd(parent.size(), true);
+	add_frame(b.node, max_sz);
+	add_branches(b.children, bd.first, bd);
+	bd.last = parent.size();
+	bodies.push_back(bd);
+	num_ligands++;
+}
+
+void flat_tree::add(const main_branch& b)
+{
+	body bd(parent.size(), false);
+	sz k = add_frame(b.node, max_sz);
+	axis[k] = b.node.axis; //fixed for the root
+	torsion[k] = 0;
+	add_branches(b.children, bd.first, bd);
+	bd.last = parent.size();
+	bodies.push_back(bd);
+}
+
+void flat_tree::finish(const atomv& atoms)
+{
+	sz n = parent.size();
+	child_start.assign(n + 1, 0);
+	VINA_FOR(k, n)
+		if (parent[k] != max_sz)
+			child_start[parent[k] + 1]++;
+	VINA_FOR(k, n)
+		child_start[k + 1] += child_start[k];
+	child_list.resize(child_start[n]);
+	szv fill(child_start.begin(), child_start.end() - 1);
+	VINA_FOR(k, n)
+		if (parent[k] != max_sz)
+			child_list[fill[parent[k]]++] = k; //increasing k is tree order
+
+	heavy_start.assign(1, 0);
+	hydrogen_start.assign(1, 0);
+	VINA_FOR(k, n)
+	{
+		VINA_RANGE(i, begin[k], end[k])
+		{
+			if (atoms[i].is_hydrogen())
+				hydrogen_list.push_back(i);
+			else
+				heavy_list.push_back(i);
+		}
+		heavy_start.push_back(heavy_list.size());
+		hydrogen_start.push_back(hydrogen_list.size());
+	}
+
+	force.resize(n);
+	torque.resize(n);
+
+	x.resize(atoms.size());
+	y.resize(atoms.size());
+	z.resize(atoms.size());
+	VINA_FOR_IN(i, atoms)
+	{
+		x[i] = atoms[i].coords[0];
+		y[i] = atoms[i].coords[1];
+		z[i] = atoms[i].coords[2];
+	}
+	built_for = atoms.size();
+}
+
+//atom_frame::set_coords
+void flat_tree::set_atoms(sz k, vecv& coords) const
+{
+	const fl* m = orientation_m[k].data;
+	const vec& o = origin[k];
+	VINA_RANGE(i, begin[k], end[k])
+	{
+		coords[i] = vec(o[0] + (m[0] * x[i] + m[3] * y[i] + m[6] * z[i]),
+				o[1] + (m[1] * x[i] + m[4] * y[i] + m[7] * z[i]),
+				o[2] + (m[2] * x[i] + m[5] * y[i] + m[8] * z[i]));
+	}
+}
+
+//the atoms of frame k in list[start[k], start[k+1])
+void flat_tree::set_atoms(sz k, const szv& list, const szv& start,
+		vecv& coords) const
+{
+	const fl* m = orientation_m[k].data;
+	const vec& o = origin[k];
+	VINA_RANGE(j, start[k], start[k + 1])
+	{
+		sz i = list[j];
+		coords[i] = vec(o[0] + (m[0] * x[i] + m[3] * y[i] + m[6] * z[i]),
+				o[1] + (m[1] * x[i] + m[4] * y[i] + m[7] * z[i]),
+				o[2] + (m[2] * x[i] + m[5] * y[i] + m[8] * z[i]));
+	}
+}
+
+void flat_tree::set_body(const body& bd, const rigid_conf* rigid,
+		const flv& torsions, vecv& coords, bool heavy_only)
+{
+	sz k = bd.first;
+	if (rigid) //rigid_body::set_conf
+	{
+		origin[k] = rigid->position;
+		orientation_q[k] = rigid->orientation;
+	}
+	else //first_segment::set_conf
+		orientation_q[k] = angle_to_quaternion(axis[k], torsions[0]);
+	orientation_m[k] = quaternion_to_r3(orientation_q[k]);
+	if (heavy_only)
+		set_atoms(k, heavy_list, heavy_start, coords);
+	else
+		set_atoms(k, coords);
+
+	for (k = bd.first + 1; k < bd.last; k++) //segment::set_conf
+	{
+		sz p = parent[k];
+		origin[k] = origin[p] + orientation_m[p] * relative_origin[k];
+		axis[k] = orientation_m[p] * relative_axis[k];
+		qt tmp = angle_to_quaternion(axis[k], torsions[torsion[k]])
+				* orientation_q[p];
+		quaternion_normalize_approx(tmp);
+		orientation_q[k] = tmp;
+		orientation_m[k] = quaternion_to_r3(tmp);
+		if (heavy_only)
+			set_atoms(k, heavy_list, heavy_start, coords);
+		else
+			set_atoms(k, coords);
+	}
+}
+
+void flat_tree::set_conf(const conf& c, vecv& coords, bool heavy_only)
+{
+	assert(c.ligands.size() == num_ligands);
+	assert(c.flex.size() == bodies.size() - num_ligands);
+	VINA_FOR_IN(i, bodies)
+	{
+		if (i < num_ligands)
+			set_body(bodies[i], &c.ligands[i].rigid, c.ligands[i].torsions,
+					coords, heavy_only);
+		else
+			set_body(bodies[i], NULL, c.flex[i - num_ligands].torsions, coords,
+					heavy_only);
+	}
+}
+
+void flat_tree::set_hydrogens(vecv& coords) const
+{
+	VINA_FOR_IN(k, parent)
+		set_atoms(k, hydrogen_list, hydrogen_start, coords);
+}
+
+//children are complete before their parent, and are added to it in tree
+//order, so sums accumulate exactly as in tree::derivative
+void flat_tree::derivative_body(const body& bd, const vecv& coords,
+		const vecv& forces, rigid_change* rigid, flv& torsions,
+		bool heavy_only)
+{
+	for (sz k = bd.last; k-- > bd.first;)
+	{
+		const vec& o = origin[k];
+		vec f(0, 0, 0);
+		vec t(0, 0, 0);
+		if (heavy_only)
+		{
+			VINA_RANGE(j, heavy_start[k], heavy_start[k + 1])
+			{
+				sz i = heavy_list[j];
+				f += forces[i];
+				t += cross_product(coords[i] - o, forces[i]);
+			}
+		}
+		else
+		{
+			VINA_RANGE(i, begin[k], end[k])
+			{
+				f += forces[i];
+				t += cross_product(coords[i] - o, forces[i]);
+			}
+		}
+		VINA_RANGE(j, child_start[k], child_start[k + 1])
+		{
+			sz ch = child_list[j];
+			f += force[ch];
+			vec r;
+			r = origin[ch] - o;
+			t += cross_product(r, force[ch]) + torque[ch];
+		}
+		force[k] = f;
+		torque[k] = t;
+		if (torsion[k] != max_sz)
+			torsions[torsion[k]] = t * axis[k];
+	}
+	if (rigid)
+	{
+		rigid->position = force[bd.first];
+		rigid->orientation = torque[bd.first];
+	}
+}
+
+void flat_tree::derivative(const vecv& coords, const vecv& forces, change& g,
+		bool heavy_only)
+{
+	VINA_FOR_IN(i, bodies)
+	{
+		if (i < num_ligands)
+			derivative_body(bodies[i], coords, forces, &g.ligands[i].rigid,
+					g.ligands[i].torsions, heavy_only);
+		else
+			derivative_body(bodies[i], coords, forces, NULL,
+					g.flex[i - num_ligands].torsions, heavy_only);
+	}
+}
+
+void flat_tree::write_root(sz i, frame& f) const
+{
+	sz k = bodies[i].first;
+	f.origin = origin[k];
+	f.orientation_q = orientation_q[k];
+	f.orientation_m = orientation_m[k];
+}
@@ -0,0 +1,112 @@
+/*
+ * flat_tree.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_FLAT_TREE_H
+#define SMINA_FLAT_TREE_H
+
+#include "common.h"
+#include "tree.h"
+
+// The torsion trees of a model's ligands and flexible residues flattened into
+// one array of frames in depth-first order, so that conf -> coords and the
+// force/torque back-propagation are loops over arrays instead of recursion
+// through nested tree/heterotree vectors. Atom local coordinates are copied
+// into separate x/y/z arrays. The arithmetic is the same as in tree.h, in the
+// same order, so results are identical.
+// Only the root frames are written back into the trees (see write_root);
+// segment nodes in the trees are not kept up to date.
+// Nothing scores hydrogens, so a search can move only the heavy atoms and
+// place the hydrogens from the saved frames when a pose is needed in full.
+class flat_tree
+{
+public:
+	flat_tree() :
+			num_ligands(0), built_for(max_sz)
+	{
+	}
+
+	//true if built for a model with this many atoms, ligands and residues
+	bool current(sz num_atoms, sz ligands, sz residues) const
+	{
+		return built_for == num_atoms && num_ligands == ligands
+				&& bodies.size() == ligands + residues;
+	}
+
+	//ligands must all be added before any residue
+	void clear();
+	void add(const flexible_body& b);
+	void add(const main_branch& b);
+	void finish(const atomv& atoms);
+
+	//same as vector_mutable::set_conf for the ligands and then the residues;
+	//with heavy_only, hydrogen coordinates are left as they were
+	void set_conf(const conf& c, vecv& coords, bool heavy_only);
+	//place the hydrogens using the frames of the last set_conf
+	void set_hydrogens(vecv& coords) const;
+	//same as vector_mutable::derivative, using the frames of the last set_conf;
+	//with heavy_only, forces on hydrogens are ignored
+	void derivative(const vecv& coords, const vecv& forces, change& g,
+			bool heavy_only);
+
+	//copy the root frame of body i (ligands first) computed by set_conf into
+	//the tree node it was built from
+	void write_root(sz i, frame& f) const;
+
+private:
+	struct body
+	{
+		sz first; //frames [first, last)
+		sz last;
+		bool ligand; //rigid_body root, else first_segment root
+		body(sz f, bool l) :
+				first(f), last(f), ligand(l)
+		{
+		}
+	};
+
+	std::vector<body> bodies;
+	sz num_ligands;
+	sz built_for;
+
+	//per frame, depth-first within each body
+	szv parent; //max_sz for roots
+	szv begin; //atom range
+	szv end;
+	szv torsion; //index into the torsions of the body's conf, max_sz if none
+	vecv relative_origin; //segments only
+	vecv relative_axis;
+	szv child_start; //children of k are child_list[child_start[k], child_start[k+1])
+	szv child_list;
+	szv heavy_start; //same layout for the non-hydrogen atoms of each frame
+	szv heavy_list;
+	szv hydrogen_start; //and the hydrogens
+	szv hydrogen_list;
+
+	//per frame state, set by set_conf
+	vecv origin;
+	vecv axis;
+	std::vector<qt> orientation_q;
+	std::vector<mat> orientation_m;
+
+	//scratch for derivative
+	vecv force;
+	vecv torque;
+
+	//atom local coordinates
+	flv x, y, z;
+
+	sz add_frame(const atom_frame& f, sz parent_);
+	void add_branches(const branches& b, sz parent_, body& bd);
+	void set_atoms(sz k, vecv& coords) const;
+	void set_atoms(sz k, const szv& list, const szv& start, vecv& coords) const;
+	void set_body(const body& bd, const rigid_conf* rigid, const flv& torsions,
+			vecv& coords, bool heavy_only);
+	void derivative_body(const body& bd, const vecv& coords,
+			const vecv& forces, rigid_change* rigid, flv& torsions,
+			bool heavy_only);
+};
+
+#endif /* SMINA_FLAT_TREE_H */
@@ -93,12 +93,12 @@ void FlexInfo::sanitizeFlexres(OpenBabel::OBMol& receptor){
 }
 
 void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
-		std::string& flexpdbqt)
+		std::vector<OpenBabel::OBMol>& flex)
 {
 	using namespace OpenBabel;
 	rigid = receptor;
 	rigid.SetChainsPerceived(); //workaround for openbabel bug
-	flexpdbqt.clear();
+	flex.clear();
 
 	//identify residues close to distligand here
 	Box b;
@@ -169,9 +169,6 @@ void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
 	residues.clear();
 	residues.insert(sortedres.begin(), sortedres.end());
 
-	OBConversion conv;
-	conv.SetOutFormat("PDBQT");
-	conv.AddOption("s", OBConversion::OUTOPTIONS); //flexible residue
 	rigid.BeginModify();
 	int foundcnt = 0;
 	//identify atoms that have to be in flexible component
@@ -187,7 +184,7 @@ void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
 		{
 			foundcnt += 1;
 			//create a separate molecule for each flexible residue
-			OBMol flex;
+			OBMol flexmol;
 			std::vector<OBAtom*> flexatoms; //rigid atom ptrs that should be flexible
 			boost::unordered_map<OBAtom*, int> flexmap; //map rigid atom ptrs to atom indices in flex
 
@@ -201,8 +198,8 @@ void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
 				if(aid == "CA" || aid == "C")
 				{
 					flexatoms.push_back(a);
-					flex.AddAtom(*a);
-					flexmap[a] = flex.NumAtoms(); //after addatom since indexed by
+					flexmol.AddAtom(*a);
+					flexmap[a] = flexmol.NumAtoms(); //after addatom since indexed by
 				}
 			}
 
@@ -216,8 +213,8 @@ void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
 						 !a->IsNonPolarHydrogen())
 				{
 					flexatoms.push_back(a);
-					flex.AddAtom(*a);
-					flexmap[a] = flex.NumAtoms(); //after addatom since indexed by
+					flexmol.AddAtom(*a);
+					flexmap[a] = flexmol.NumAtoms(); //after addatom since indexed by
 				}
 			}
 
@@ -232,20 +229,20 @@ void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
 					//and second atom is a flexatom need to add bond
 					if(a == bond.GetBeginAtom() && flexmap.count(bond.GetEndAtom()))
 					{
-						flex.AddBond(flexmap[a],flexmap[bond.GetEndAtom()],bond.GetBondOrder(), bond.GetFlags());
+						flexmol.AddBond(flexmap[a],flexmap[bond.GetEndAtom()],bond.GetBondOrder(), bond.GetFlags());
 					}
 				}
 			}
 
-			flex.AddResidue(*r);
-			OBResidue *newres = flex.GetResidue(0);
+			flexmol.AddResidue(*r);
+			OBResidue *newres = flexmol.GetResidue(0);
 			if(newres)
 			{
 				//add all atoms with proper atom ids
 				for(unsigned i = 0, n = flexatoms.size(); i < n; i++)
 				{
 					OBAtom *origa = flexatoms[i];
-					OBAtom *newa = flex.GetAtom(flexmap[origa]);
+					OBAtom *newa = flexmol.GetAtom(flexmap[origa]);
 					newres->RemoveAtom(origa);
 					newres->AddAtom(newa);
 					newa->SetResidue(newres);
@@ -254,56 +251,7 @@ void FlexInfo::extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid,
 				}
 			}
 
-			std::string flexres = conv.WriteString(&flex);
-
-			if(newres)
-			{
-				//the pdbqt writing code breaks flex into fragments, in the process it loses all residue information
-				//so we rewrite the strings..
-				std::vector<std::string> tokens;
-				std::string resn = newres->GetName();
-				while(resn.size() < 3)
-					resn += " ";
-
-				std::string resnum = boost::lexical_cast<std::string>(newres->GetNum());
-				while(resnum.size() < 4)
-					resnum = " " + resnum;
-
-				char ch = newres->GetChain();
-				char icode = newres->GetInsertionCode();
-				boost::split(tokens, flexres, boost::is_any_of("\n"));
-				for(unsigned i = 0, n = tokens.size(); i < n; i++)
-				{
-					std::string line = tokens[i];
-					if(line.size() > 26)
-					{
-						//replace UNL with resn
-						for(unsigned p = 0; p < 3; p++)
-						{
-							line[17+p] = resn[p];
-						}
-						//resid
-						for(unsigned p = 0; p < 4; p++)
-						{
-							line[22+p] = resnum[p];
-						}
-						
-						line[21] = ch;
-	          if(icode > 0) {
-	            line[26] = icode;
-	          }
-					}
-					if(line.size() > 0)
-					{
-						flexpdbqt += line;
-						flexpdbqt += "\n";
-					}
-				}
-			}
-			else
-			{
-				flexpdbqt += flexres;
-			}
+			flex.push_back(flexmol);
 
 			//remove flexatoms from rigid
 			for(unsigned i = 0, n = flexatoms.size(); i < n; i++)
@@ -59,7 +59,9 @@ public:
 
 	void sanitizeFlexres(OpenBabel::OBMol& receptor);
 
-	void extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid, std::string& flexpdbqt);
+	//rigid gets the receptor without the flexible atoms, flex a molecule for
+	//each flexible residue, CA first
+	void extractFlex(OpenBabel::OBMol& receptor, OpenBabel::OBMol& rigid, std::vector<OpenBabel::OBMol>& flex);
 
 };
 
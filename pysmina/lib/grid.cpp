@@ -24,29 +24,6 @@
 #include "grid_dim.h"
 #include "common.h"
 
-//evaluate using grid, if deriv is null, do not calc deriviative
-fl grid::evaluate(const atom& a, const vec& location, fl slope, fl c,
-		vec *deriv /*=NULL*/) const
-		{
-	//charge indep
-	fl ret = evaluate_aux(data, location, slope, c, deriv);
-	if (a.charge != 0 && chargedata.dim0() > 0)
-	{
-		//charge dependent
-		if(deriv == NULL)
-		{
-			ret += a.charge * evaluate_aux(chargedata, location, slope, c, NULL);
-		}
-		else //otherwise, must add derivatives
-		{
-			vec cderiv(0,0,0);
-			ret += a.charge * evaluate_aux(chargedata, location, slope, c, &cderiv);
-			*deriv += a.charge*cderiv;
-		}
-	}
-	return ret;
-}
-
 fl grid::evaluate_user(const vec& location, fl slope, vec *deriv) const
 {
     return evaluate_aux(data, location, slope, (fl) 1000, deriv);
@@ -59,14 +36,17 @@ void grid::init(const grid_dims& gd, bool hascharged)
 	data.resize(gd[0].n + 1, gd[1].n + 1, gd[2].n + 1);
 	if(hascharged)
 		chargedata.resize(gd[0].n + 1, gd[1].n + 1, gd[2].n + 1);
+	init_geometry(gd);
+}
+
+void grid::init_geometry(const grid_dims& gd)
+{
 	m_init = vec(gd[0].begin, gd[1].begin, gd[2].begin);
 	m_range = vec(gd[0].span(), gd[1].span(), gd[2].span());
 	assert(m_range[0] > 0);
 	assert(m_range[1] > 0);
 	assert(m_range[2] > 0);
-	m_dim_fl_minus_1 = vec(data.dim0() - 1.0,
-			data.dim1() - 1.0,
-			data.dim2() - 1.0);
+	m_dim_fl_minus_1 = vec(gd[0].n, gd[1].n, gd[2].n);
 	VINA_FOR(i, 3)
 	{
 		m_factor[i] = m_dim_fl_minus_1[i] / m_range[i];
@@ -107,130 +87,186 @@ void grid::init(const grid_dims& gd, std::istream& user_in, fl ug_scaling_factor
 	}
 }
 
-
-fl grid::evaluate_aux(const array3d<fl>& m_data, const vec& location, fl slope,
-		fl v, vec* deriv) const
-		{ // sets *deriv if not NULL
-	vec s = elementwise_product(location - m_init, m_factor);
-	
-	vec miss(0, 0, 0);
-	boost::array<int, 3> region;
-	boost::array<sz, 3> a;
-
-	VINA_FOR(i, 3)
+//branch free version of locate; every loop runs over the whole block
+void grid::locate(const fl* const coords[3], sz n, fl slope, cell_block& c) const
+{
+	assert(n <= block_size);
+	fl miss[3][block_size];
+	int a[3][block_size];
+	c.n = n;
+	VINA_FOR(d, 3)
 	{
-		if (s[i] < 0)
+		const fl* x = coords[d];
+		const fl init = m_init[d];
+		const fl factor = m_factor[d];
+		const fl top = m_dim_fl_minus_1[d];
+		fl* s = c.s[d];
+		fl* region = c.region[d];
+		fl* md = miss[d];
+		int* ad = a[d];
+		for (sz i = 0; i < n; i++)
 		{
-			miss[i] = -s[i];
-			region[i] = -1;
-			a[i] = 0;
-			s[i] = 0;
+			//all arithmetic is unconditional, only the results are selected
+			const fl si = (x[i] - init) * factor;
+			const bool below = si < 0;
+			const bool above = si >= top;
+			//lower corner as in locate: 0 below the grid, top - 1 above it
+			const fl clamped = below ? 0 : si;
+			const int ai = int((clamped < top - 1) ? clamped : top - 1);
+			const fl inside = si - ai;
+			const fl over = si - top;
+			const fl under = -si;
+			ad[i] = ai;
+			s[i] = above ? 1 : (below ? 0 : inside);
+			md[i] = above ? over : (below ? under : 0);
+			region[i] = above ? 1 : (below ? -1 : 0);
 		}
-		else if (s[i] >= m_dim_fl_minus_1[i])
-		{
-			miss[i] = s[i] - m_dim_fl_minus_1[i];
-			region[i] = 1;
-			assert(m_data.dim(i) >= 2);
-			a[i] = m_data.dim(i) - 2;
-			s[i] = 1;
-		}
-		else
-		{
-			region[i] = 0; // now that region is boost::array, it's not initialized
-			a[i] = sz(s[i]);
-			s[i] -= a[i];
-		}
-		assert(s[i] >= 0);
-		assert(s[i] <= 1);
-		assert(a[i] >= 0);
-		assert(a[i]+1 < m_data.dim(i));
 	}
-	const fl penalty = slope * (miss * m_factor_inv); // FIXME check that inv_factor is correctly initialized and serialized
-	assert(penalty > -epsilon_fl);
-
-	const sz x0 = a[0];
-	const sz y0 = a[1];
-	const sz z0 = a[2];
-
-	const sz x1 = x0 + 1;
-	const sz y1 = y0 + 1;
-	const sz z1 = z0 + 1;
-
-	const fl f000 = m_data(x0, y0, z0);
-	const fl f100 = m_data(x1, y0, z0);
-	const fl f010 = m_data(x0, y1, z0);
-	const fl f110 = m_data(x1, y1, z0);
-	const fl f001 = m_data(x0, y0, z1);
-	const fl f101 = m_data(x1, y0, z1);
-	const fl f011 = m_data(x0, y1, z1);
-	const fl f111 = m_data(x1, y1, z1);
-
-	const fl x = s[0];
-	const fl y = s[1];
-	const fl z = s[2];
-
-	const fl mx = 1 - x;
-	const fl my = 1 - y;
-	const fl mz = 1 - z;
-
-	fl f =
-			f000 * mx * my * mz +
-					f100 * x * my * mz +
-					f010 * mx * y * mz +
-					f110 * x * y * mz +
-					f001 * mx * my * z +
-					f101 * x * my * z +
-					f011 * mx * y * z +
-					f111 * x * y * z;
-
-	if (deriv)
-	{ // valid pointer
+	//a grid is far smaller than 2^31 points, so int indices are enough
+	const int dim0 = int(m_dim_fl_minus_1[0]) + 1;
+	const int dim1 = int(m_dim_fl_minus_1[1]) + 1;
+	for (sz i = 0; i < n; i++)
+		c.corner[i] = a[0][i] + dim0 * (a[1][i] + dim1 * a[2][i]);
+	for (sz i = 0; i < n; i++)
+		c.penalty[i] = slope * (miss[0][i] * m_factor_inv[0]
+				+ miss[1][i] * m_factor_inv[1] + miss[2][i] * m_factor_inv[2]);
+}
+
+//same arithmetic as interpolate for a single cell, so results are identical;
+//the corners are indexed loads, which the compiler turns into gathers when
+//tuning for a target where they pay off (e.g. -march=skylake)
+void grid::interpolate(const fl* m_data, const cell_block& c, fl slope, fl v,
+		fl* values, fl (*derivs)[block_size]) const
+{
+	const sz n = c.n;
+	const int dim0 = int(m_dim_fl_minus_1[0]) + 1;
+	const int dim01 = dim0 * (int(m_dim_fl_minus_1[1]) + 1);
+	const int* corner = c.corner;
+	const fl* x = c.s[0];
+	const fl* y = c.s[1];
+	const fl* z = c.s[2];
+
+	fl f000[block_size], f100[block_size], f010[block_size], f110[block_size];
+	fl f001[block_size], f101[block_size], f011[block_size], f111[block_size];
+	for (sz i = 0; i < n; i++)
+	{
+		f000[i] = m_data[corner[i]];
+		f100[i] = m_data[corner[i] + 1];
+		f010[i] = m_data[corner[i] + dim0];
+		f110[i] = m_data[corner[i] + dim0 + 1];
+		f001[i] = m_data[corner[i] + dim01];
+		f101[i] = m_data[corner[i] + dim01 + 1];
+		f011[i] = m_data[corner[i] + dim01 + dim0];
+		f111[i] = m_data[corner[i] + dim01 + dim0 + 1];
+	}
+
+	//curl as a factor that is exactly 1 where it doesn't apply
+	fl scale[block_size];
+	const bool curled = not_max(v);
+	const fl curl_zero = (v < epsilon_fl) ? 0 : 1;
+	for (sz i = 0; i < n; i++)
+	{
+		const fl mx = 1 - x[i];
+		const fl my = 1 - y[i];
+		const fl mz = 1 - z[i];
+
+		const fl f =
+				f000[i] * mx * my * mz +
+						f100[i] * x[i] * my * mz +
+						f010[i] * mx * y[i] * mz +
+						f110[i] * x[i] * y[i] * mz +
+						f001[i] * mx * my * z[i] +
+						f101[i] * x[i] * my * z[i] +
+						f011[i] * mx * y[i] * z[i] +
+						f111[i] * x[i] * y[i] * z[i];
+
+		const fl tmp = curl_zero * (v / (v + f));
+		const fl when_positive = curled ? tmp : 1;
+		scale[i] = (f > 0) ? when_positive : 1;
+		values[i] = f * scale[i] + c.penalty[i];
+	}
+	if (!derivs)
+		return;
+
+	for (sz i = 0; i < n; i++)
+	{
+		const fl mx = 1 - x[i];
+		const fl my = 1 - y[i];
+		const fl mz = 1 - z[i];
+
 		const fl x_g =
-				f000 * (-1) * my * mz +
-						f100 * 1 * my * mz +
-						f010 * (-1) * y * mz +
-						f110 * 1 * y * mz +
-						f001 * (-1) * my * z +
-						f101 * 1 * my * z +
-						f011 * (-1) * y * z +
-						f111 * 1 * y * z;
+				f000[i] * (-1) * my * mz +
+						f100[i] * 1 * my * mz +
+						f010[i] * (-1) * y[i] * mz +
+						f110[i] * 1 * y[i] * mz +
+						f001[i] * (-1) * my * z[i] +
+						f101[i] * 1 * my * z[i] +
+						f011[i] * (-1) * y[i] * z[i] +
+						f111[i] * 1 * y[i] * z[i];
 
 		const fl y_g =
-				f000 * mx * (-1) * mz +
-						f100 * x * (-1) * mz +
-						f010 * mx * 1 * mz +
-						f110 * x * 1 * mz +
-						f001 * mx * (-1) * z +
-						f101 * x * (-1) * z +
-						f011 * mx * 1 * z +
-						f111 * x * 1 * z;
+				f000[i] * mx * (-1) * mz +
+						f100[i] * x[i] * (-1) * mz +
+						f010[i] * mx * 1 * mz +
+						f110[i] * x[i] * 1 * mz +
+						f001[i] * mx * (-1) * z[i] +
+						f101[i] * x[i] * (-1) * z[i] +
+						f011[i] * mx * 1 * z[i] +
+						f111[i] * x[i] * 1 * z[i];
 
 		const fl z_g =
-				f000 * mx * my * (-1) +
-						f100 * x * my * (-1) +
-						f010 * mx * y * (-1) +
-						f110 * x * y * (-1) +
-						f001 * mx * my * 1 +
-						f101 * x * my * 1 +
-						f011 * mx * y * 1 +
-						f111 * x * y * 1;
-
-		vec gradient(x_g, y_g, z_g);
-		curl(f, gradient, v);
-		vec gradient_everywhere;
-
-		VINA_FOR(i, 3)
+				f000[i] * mx * my * (-1) +
+						f100[i] * x[i] * my * (-1) +
+						f010[i] * mx * y[i] * (-1) +
+						f110[i] * x[i] * y[i] * (-1) +
+						f001[i] * mx * my * 1 +
+						f101[i] * x[i] * my * 1 +
+						f011[i] * mx * y[i] * 1 +
+						f111[i] * x[i] * y[i] * 1;
+
+		const fl scale2 = sqr(scale[i]);
+		const fl cx = x_g * scale2;
+		const fl cy = y_g * scale2;
+		const fl cz = z_g * scale2;
+		const fl gx = (c.region[0][i] == 0) ? cx : 0;
+		const fl gy = (c.region[1][i] == 0) ? cy : 0;
+		const fl gz = (c.region[2][i] == 0) ? cz : 0;
+		derivs[0][i] = m_factor[0] * gx + slope * c.region[0][i];
+		derivs[1][i] = m_factor[1] * gy + slope * c.region[1][i];
+		derivs[2][i] = m_factor[2] * gz + slope * c.region[2][i];
+	}
+}
+
+//evaluate_cell for a located block: the charge independent and charge
+//dependent grids share the cells
+fl grid::evaluate(const cell_block& c, const fl* charges, fl slope, fl v, vec* derivs) const
+{
+	const sz n = c.n;
+	fl e[block_size];
+	fl d[3][block_size];
+	interpolate(data.flat(), c, slope, v, e, derivs ? d : NULL);
+	if (chargedata.dim0() > 0)
+	{
+		fl ce[block_size];
+		fl cd[3][block_size];
+		interpolate(chargedata.flat(), c, slope, v, ce, derivs ? cd : NULL);
+		//nothing changes for uncharged atoms, as if they were skipped
+		for (sz i = 0; i < n; i++)
+			e[i] += charges[i] * ce[i];
+		if (derivs)
 		{
-			gradient_everywhere[i] = ((region[i] == 0) ? gradient[i] : 0);
-			(*deriv)[i] = m_factor[i] * gradient_everywhere[i]
-					+ slope * region[i];
+			VINA_FOR(j, 3)
+				for (sz i = 0; i < n; i++)
+					d[j][i] += charges[i] * cd[j][i];
 		}
-
-		return f + penalty;
 	}
-	else
+	fl ret = 0;
+	for (sz i = 0; i < n; i++)
+		ret += e[i];
+	if (derivs)
 	{
-		curl(f, v);
-		return f + penalty;
+		for (sz i = 0; i < n; i++)
+			derivs[i] = vec(d[0][i], d[1][i], d[2][i]);
 	}
+	return ret;
 }
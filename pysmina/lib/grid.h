@@ -63,11 +63,68 @@ class grid
 	{
 		return data.dim0() > 0 && data.dim1() > 0 && data.dim2() > 0;
 	}
-	fl evaluate(const atom& a, const vec& location, fl slope, fl c, vec* deriv = NULL) const;
+	fl evaluate(const atom& a, const vec& location, fl slope, fl c, vec* deriv = NULL) const
+	{
+		return evaluate_data(data, chargedata.dim0() > 0 ? &chargedata : NULL,
+				a, location, slope, c, deriv);
+	}
     fl evaluate_user(const vec& location, fl slope, vec* deriv = NULL) const;
+
+	//this grid's geometry without allocating any data
+	void init_geometry(const grid_dims& gd);
+	//evaluate against values held elsewhere (e.g. lazily computed tiles);
+	//Data needs dim(i) and operator()(x, y, z) like array3d<fl>
+	template<typename Data>
+	fl evaluate_data(const Data& data, const Data* charged, const atom& a,
+			const vec& location, fl slope, fl c, vec* deriv = NULL) const;
+
+	//where a location falls in a grid of this geometry; all grids built
+	//from the same grid_dims can share one
+	struct cell
+	{
+		sz a[3]; //lower corner
+		vec s; //position within the cell, each coordinate in [0, 1]
+		int region[3]; //-1 below the grid, 1 above it, 0 inside
+		fl penalty; //slope times the distance outside the grid
+	};
+	void locate(const vec& location, fl slope, cell& c) const;
+
+	//up to block_size atoms of one type located together, as structure of
+	//arrays so that each step is a plain loop over the block
+	static const sz block_size = 16;
+	struct cell_block
+	{
+		sz n;
+		int corner[block_size]; //index of the lower corner in the data
+		fl s[3][block_size]; //position within the cell, as in cell
+		fl region[3][block_size]; //-1, 0 or 1, as in cell
+		fl penalty[block_size];
+	};
+	//same as locate for n <= block_size atoms, given one array per axis
+	void locate(const fl* const coords[3], sz n, fl slope, cell_block& c) const;
+	//sum of the energies of a located block, the charge grid scaled by
+	//charges; sets derivs[0..n) if not NULL
+	fl evaluate(const cell_block& c, const fl* charges, fl slope, fl v, vec* derivs) const;
+	//evaluate_data for an already located atom
+	template<typename Data>
+	fl evaluate_cell(const Data& data, const Data* charged, const atom& a,
+			const cell& where, fl slope, fl c, vec* deriv = NULL) const;
 private:
-	fl evaluate_aux(const array3d<fl>& m_data, const vec& location, fl slope,
+	template<typename Data>
+	fl evaluate_aux(const Data& m_data, const vec& location, fl slope,
+			fl v, vec* deriv) const // sets *deriv if not NULL
+	{
+		cell where;
+		locate(location, slope, where);
+		return interpolate(m_data, where, slope, v, deriv);
+	}
+	template<typename Data>
+	fl interpolate(const Data& m_data, const cell& where, fl slope,
 			fl v, vec* deriv) const; // sets *deriv if not NULL
+	//interpolate for a located block; values are curled, penalty added,
+	//and derivs are set if not NULL
+	void interpolate(const fl* m_data, const cell_block& c, fl slope, fl v,
+			fl* values, fl (*derivs)[block_size]) const;
 	friend class boost::serialization::access;
 	template<class Archive>
 	void serialize(Archive& ar, const unsigned version)
@@ -82,4 +139,174 @@ private:
 	}
 };
 
+//evaluate using grid, if deriv is null, do not calc deriviative
+//charged is NULL if there are no charge dependent terms
+template<typename Data>
+fl grid::evaluate_data(const Data& data, const Data* charged, const atom& a,
+		const vec& location, fl slope, fl c, vec *deriv) const
+		{
+	cell where;
+	locate(location, slope, where);
+	return evaluate_cell(data, charged, a, where, slope, c, deriv);
+}
+
+//the charge dependent part reuses the location of the charge independent one
+template<typename Data>
+fl grid::evaluate_cell(const Data& data, const Data* charged, const atom& a,
+		const cell& where, fl slope, fl c, vec *deriv) const
+		{
+	//charge indep
+	fl ret = interpolate(data, where, slope, c, deriv);
+	if (a.charge != 0 && charged != NULL)
+	{
+		const Data& chargedata = *charged;
+		//charge dependent
+		if(deriv == NULL)
+		{
+			ret += a.charge * interpolate(chargedata, where, slope, c, NULL);
+		}
+		else //otherwise, must add derivatives
+		{
+			vec cderiv(0,0,0);
+			ret += a.charge * interpolate(chargedata, where, slope, c, &cderiv);
+			*deriv += a.charge*cderiv;
+		}
+	}
+	return ret;
+}
+
+inline void grid::locate(const vec& location, fl slope, cell& c) const
+{
+	vec s = elementwise_product(location - m_init, m_factor);
+	vec miss(0, 0, 0);
+
+	VINA_FOR(i, 3)
+	{
+		if (s[i] < 0)
+		{
+			miss[i] = -s[i];
+			c.region[i] = -1;
+			c.a[i] = 0;
+			s[i] = 0;
+		}
+		else if (s[i] >= m_dim_fl_minus_1[i])
+		{
+			miss[i] = s[i] - m_dim_fl_minus_1[i];
+			c.region[i] = 1;
+			assert(m_dim_fl_minus_1[i] >= 1);
+			c.a[i] = sz(m_dim_fl_minus_1[i]) - 1;
+			s[i] = 1;
+		}
+		else
+		{
+			c.region[i] = 0;
+			c.a[i] = sz(s[i]);
+			s[i] -= c.a[i];
+		}
+		assert(s[i] >= 0);
+		assert(s[i] <= 1);
+	}
+	c.s = s;
+	c.penalty = slope * (miss * m_factor_inv); // FIXME check that inv_factor is correctly initialized and serialized
+	assert(c.penalty > -epsilon_fl);
+}
+
+template<typename Data>
+fl grid::interpolate(const Data& m_data, const cell& where, fl slope,
+		fl v, vec* deriv) const
+		{ // sets *deriv if not NULL
+	const sz* a = where.a;
+	const vec& s = where.s;
+	const int* region = where.region;
+	const fl penalty = where.penalty;
+	VINA_FOR(i, 3)
+		assert(a[i]+1 < m_data.dim(i));
+
+	const sz x0 = a[0];
+	const sz y0 = a[1];
+	const sz z0 = a[2];
+
+	const sz x1 = x0 + 1;
+	const sz y1 = y0 + 1;
+	const sz z1 = z0 + 1;
+
+	const fl f000 = m_data(x0, y0, z0);
+	const fl f100 = m_data(x1, y0, z0);
+	const fl f010 = m_data(x0, y1, z0);
+	const fl f110 = m_data(x1, y1, z0);
+	const fl f001 = m_data(x0, y0, z1);
+	const fl f101 = m_data(x1, y0, z1);
+	const fl f011 = m_data(x0, y1, z1);
+	const fl f111 = m_data(x1, y1, z1);
+
+	const fl x = s[0];
+	const fl y = s[1];
+	const fl z = s[2];
+
+	const fl mx = 1 - x;
+	const fl my = 1 - y;
+	const fl mz = 1 - z;
+
+	fl f =
+			f000 * mx * my * mz +
+					f100 * x * my * mz +
+					f010 * mx * y * mz +
+					f110 * x * y * mz +
+					f001 * mx * my * z +
+					f101 * x * my * z +
+					f011 * mx * y * z +
+					f111 * x * y * z;
+
+	if (deriv)
+	{ // valid pointer
+		const fl x_g =
+				f000 * (-1) * my * mz +
+						f100 * 1 * my * mz +
+						f010 * (-1) * y * mz +
+						f110 * 1 * y * mz +
+						f001 * (-1) * my * z +
+						f101 * 1 * my * z +
+						f011 * (-1) * y * z +
+						f111 * 1 * y * z;
+
+		const fl y_g =
+				f000 * mx * (-1) * mz +
+						f100 * x * (-1) * mz +
+						f010 * mx * 1 * mz +
+						f110 * x * 1 * mz +
+						f001 * mx * (-1) * z +
+						f101 * x * (-1) * z +
+						f011 * mx * 1 * z +
+						f111 * x * 1 * z;
+
+		const fl z_g =
+				f000 * mx * my * (-1) +
+						f100 * x * my * (-1) +
+						f010 * mx * y * (-1) +
+						f110 * x * y * (-1) +
+						f001 * mx * my * 1 +
+						f101 * x * my * 1 +
+						f011 * mx * y * 1 +
+						f111 * x * y * 1;
+
+		vec gradient(x_g, y_g, z_g);
+		curl(f, gradient, v);
+		vec gradient_everywhere;
+
+		VINA_FOR(i, 3)
+		{
+			gradient_everywhere[i] = ((region[i] == 0) ? gradient[i] : 0);
+			(*deriv)[i] = m_factor[i] * gradient_everywhere[i]
+					+ slope * region[i];
+		}
+
+		return f + penalty;
+	}
+	else
+	{
+		curl(f, v);
+		return f + penalty;
+	}
+}
+
 #endif
@@ -73,4 +73,18 @@ inline vec grid_dims_end(const grid_dims& gd) {
 	return tmp;
 }
 
+// same box (recentered, covering at least the original) sampled at another granularity
+inline grid_dims regrid(const grid_dims& gd, fl granularity) {
+	grid_dims tmp;
+	VINA_FOR_IN(i, gd) {
+		fl center = (gd[i].begin + gd[i].end) / 2;
+		tmp[i].n = sz(std::ceil(gd[i].span() / granularity - epsilon_fl));
+		if(tmp[i].n == 0) tmp[i].n = 1;
+		fl real_span = granularity * tmp[i].n;
+		tmp[i].begin = center - real_span / 2;
+		tmp[i].end = tmp[i].begin + real_span;
+	}
+	return tmp;
+}
+
 #endif
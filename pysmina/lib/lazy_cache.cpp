@@ -0,0 +1,259 @@
+/*
+ * lazy_cache.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <mutex>
+#include "lazy_cache.h"
+#include "cache.h"
+#include "szv_grid.h"
+#include "brick.h"
+
+//array3d-like access to one type's values (or charge values), fetching
+//tiles as needed; remembers the last tile since the eight corners of an
+//interpolation always share one
+class lazy_cache::view
+{
+	const lazy_cache& c;
+	sz offset;
+	mutable const tile* t;
+	mutable sz origin[3];
+
+	void locate(sz x, sz y, sz z) const
+	{
+		sz index[3] = { x, y, z };
+		VINA_FOR(i, 3)
+		{
+			sz ti = (std::min)(index[i] / tile_cells, c.ntiles[i] - 1);
+			origin[i] = ti * tile_cells;
+			index[i] = ti;
+		}
+		t = &c.get(index[0], index[1], index[2]);
+		if (!t->used.load(std::memory_order_relaxed))
+			t->used.store(true, std::memory_order_relaxed);
+	}
+
+public:
+	view(const lazy_cache& c_, sz slot, bool charge) :
+			c(c_), offset((charge ? c_.types.size() + slot : slot) * points_per_tile), t(NULL)
+	{
+	}
+
+	sz dim(sz i) const
+	{
+		return c.dims[i];
+	}
+
+	fl operator()(sz x, sz y, sz z) const
+	{
+		if (t == NULL || x < origin[0] || y < origin[1] || z < origin[2]
+				|| x > origin[0] + tile_cells || y > origin[1] + tile_cells
+				|| z > origin[2] + tile_cells)
+			locate(x, y, z);
+		return t->data[offset + (x - origin[0])
+				+ tile_points * ((y - origin[1]) + tile_points * (z - origin[2]))];
+	}
+};
+
+lazy_cache::lazy_cache(const model& m, const precalculate& p_,
+		const grid_dims& gd_, fl slope_,
+		const std::vector<smt>& atom_types_needed, const grid& user_grid_,
+		sz memory_limit_) :
+		p(p_), user_grid(user_grid_), gd(gd_), slope(slope_),
+				charged(p_.has_components()), memory_limit(memory_limit_),
+				bytes(0), computed(0), hand(0)
+{
+	geometry.init_geometry(gd);
+
+	szv relevant;
+	szv_grid_cache gcache(m, p.cutoff_sqr());
+	gcache.compute_relevant(gd, relevant);
+	std::vector<smt> receptor_types;
+	VINA_FOR_IN(i, relevant)
+	{
+		receptor.push_back(m.grid_atoms[relevant[i]]);
+		if (!has(receptor_types, receptor.back().get()))
+			receptor_types.push_back(receptor.back().get());
+	}
+
+	//equivalent types (see cache::populate) share a slot
+	sz nat = num_atom_types();
+	slot.assign(nat, max_sz);
+	VINA_FOR_IN(i, atom_types_needed)
+	{
+		smt t = atom_types_needed[i];
+		if (t >= nat || is_hydrogen(t) || slot[t] != max_sz)
+			continue;
+		VINA_FOR_IN(j, types)
+		{
+			if (p.equivalent_types(t, types[j], receptor_types))
+			{
+				slot[t] = j;
+				break;
+			}
+		}
+		if (slot[t] == max_sz)
+		{
+			slot[t] = types.size();
+			types.push_back(t);
+		}
+	}
+
+	VINA_FOR(i, 3)
+	{
+		dims[i] = gd[i].n + 1;
+		ntiles[i] = (gd[i].n + tile_cells - 1) / tile_cells;
+		if (ntiles[i] == 0)
+			ntiles[i] = 1;
+	}
+	tiles = std::vector<std::atomic<tile*> >(ntiles[0] * ntiles[1] * ntiles[2]);
+	VINA_FOR_IN(i, tiles)
+		tiles[i].store(NULL);
+}
+
+lazy_cache::~lazy_cache()
+{
+	VINA_FOR_IN(i, tiles)
+		delete tiles[i].load();
+}
+
+//fill in all types for the points of one tile
+lazy_cache::tile* lazy_cache::compute(sz tx, sz ty, sz tz) const
+{
+	sz start[3] = { tx * tile_cells, ty * tile_cells, tz * tile_cells };
+	sz end[3]; //inclusive
+	VINA_FOR(i, 3)
+		end[i] = (std::min)(start[i] + tile_cells, dims[i] - 1);
+
+	const fl cutoff_sqr = p.cutoff_sqr();
+	vec lo = geometry.index_to_argument(start[0], start[1], start[2]);
+	vec hi = geometry.index_to_argument(end[0], end[1], end[2]);
+	szv possibilities;
+	VINA_FOR_IN(i, receptor)
+		if (brick_distance_sqr(lo, hi, receptor[i].coords) < cutoff_sqr)
+			possibilities.push_back(i);
+
+	sz ntypes = types.size();
+	tile* ret = new tile((charged ? 2 : 1) * ntypes * points_per_tile);
+	flv affinities(ntypes);
+	flv chargeaffinities(charged ? ntypes : 0);
+	for (sz x = start[0]; x <= end[0]; x++)
+		for (sz y = start[1]; y <= end[1]; y++)
+			for (sz z = start[2]; z <= end[2]; z++)
+			{
+				cache::probe(receptor, possibilities,
+						geometry.index_to_argument(x, y, z), p, types,
+						affinities, chargeaffinities);
+				fl user = 0;
+				if (user_grid.initialized()) //as in cache::populate
+					user = user_grid.evaluate_user(vec(x, y, z), slope);
+				sz point = (x - start[0])
+						+ tile_points * ((y - start[1]) + tile_points * (z - start[2]));
+				VINA_FOR(j, ntypes)
+				{
+					ret->data[j * points_per_tile + point] = affinities[j] + user;
+					if (charged)
+						ret->data[(ntypes + j) * points_per_tile + point] =
+								chargeaffinities[j];
+				}
+			}
+	return ret;
+}
+
+const lazy_cache::tile& lazy_cache::get(sz tx, sz ty, sz tz) const
+{
+	std::atomic<tile*>& entry = tiles[tx + ntiles[0] * (ty + ntiles[1] * tz)];
+	tile* t = entry.load(std::memory_order_acquire);
+	if (t == NULL)
+	{
+		tile* fresh = compute(tx, ty, tz);
+		if (entry.compare_exchange_strong(t, fresh, std::memory_order_acq_rel))
+		{
+			t = fresh;
+			bytes += sizeof(tile) + fresh->data.size() * sizeof(fl);
+			computed++;
+		}
+		else
+			delete fresh; //lost the race, t is the winner's
+	}
+	return *t;
+}
+
+//clock sweep down to 3/4 of the limit; skipped if evaluations are running
+void lazy_cache::evict() const
+{
+	std::unique_lock<std::shared_mutex> lock(evict_lock, std::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+	const sz target = memory_limit / 4 * 3;
+	for (sz steps = 0; bytes > target && steps < 2 * tiles.size(); steps++)
+	{
+		std::atomic<tile*>& entry = tiles[hand];
+		hand = (hand + 1) % tiles.size();
+		tile* t = entry.load(std::memory_order_relaxed);
+		if (t == NULL)
+			continue;
+		if (t->used.load(std::memory_order_relaxed))
+			t->used.store(false, std::memory_order_relaxed);
+		else
+		{
+			entry.store(NULL, std::memory_order_relaxed);
+			bytes -= sizeof(tile) + t->data.size() * sizeof(fl);
+			delete t;
+		}
+	}
+}
+
+//sets *minus_forces if not NULL
+fl lazy_cache::eval_aux(const model& m, fl v, vecv* minus_forces) const
+{
+	fl e = 0;
+	sz nat = num_atom_types();
+
+	VINA_FOR(i, m.num_movable_atoms())
+	{
+		const atom& a = m.atoms[i];
+		smt t = a.get();
+		if (t >= nat || is_hydrogen(t))
+		{
+			if (minus_forces)
+				(*minus_forces)[i].assign(0);
+			continue;
+		}
+		assert(slot[t] != max_sz);
+		view data(*this, slot[t], false);
+		view chargedata(*this, slot[t], true);
+		if (minus_forces)
+		{
+			vec d;
+			e += geometry.evaluate_data(data, charged ? &chargedata : NULL, a,
+					m.coords[i], slope, v, &d);
+			(*minus_forces)[i] = d;
+		}
+		else
+			e += geometry.evaluate_data(data, charged ? &chargedata : NULL, a,
+					m.coords[i], slope, v);
+	}
+	return e;
+}
+
+fl lazy_cache::eval(const model& m, fl v) const
+{
+	if (memory_limit == 0)
+		return eval_aux(m, v, NULL);
+	if (bytes > memory_limit)
+		evict();
+	std::shared_lock<std::shared_mutex> lock(evict_lock);
+	return eval_aux(m, v, NULL);
+}
+
+fl lazy_cache::eval_deriv(model& m, fl v, const grid& user_grid) const
+{
+	if (memory_limit == 0)
+		return eval_aux(m, v, &m.minus_forces);
+	if (bytes > memory_limit)
+		evict();
+	std::shared_lock<std::shared_mutex> lock(evict_lock);
+	return eval_aux(m, v, &m.minus_forces);
+}
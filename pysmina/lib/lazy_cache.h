@@ -0,0 +1,80 @@
+/*
+ * lazy_cache.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_LAZY_CACHE_H
+#define SMINA_LAZY_CACHE_H
+
+#include <atomic>
+#include <shared_mutex>
+#include "igrid.h"
+#include "grid.h"
+#include "model.h"
+
+// Grid cache for large (blind docking) boxes.  Instead of allocating and
+// filling a full grid per atom type up front like cache::populate, the box
+// is split into tiles of tile_cells^3 cells whose values, for all types at
+// once, are computed the first time an atom lands in them.  Tiles share
+// their boundary points, so every interpolation reads a single tile.
+//
+// Tiles are published with a compare-and-swap; if two threads race on the
+// same tile one copy is simply thrown away.  With a memory limit, tiles
+// not used since the last sweep are evicted (clock algorithm) between
+// evaluations, which take a shared lock only in that case.  The limit is
+// soft: one evaluation may still pull in whatever tiles it needs.
+class lazy_cache : public igrid
+{
+public:
+	lazy_cache(const model& m, const precalculate& p, const grid_dims& gd,
+			fl slope, const std::vector<smt>& atom_types_needed,
+			const grid& user_grid, sz memory_limit = 0);
+	virtual ~lazy_cache();
+
+	virtual fl eval(const model& m, fl v) const; // needs m.coords
+	virtual fl eval_deriv(model& m, fl v, const grid& user_grid) const; // needs m.coords, sets m.minus_forces
+
+	sz tiles_computed() const { return computed; }
+	sz tiles_total() const { return tiles.size(); }
+	sz memory_used() const { return bytes; }
+
+private:
+	static const sz tile_cells = 8;
+	static const sz tile_points = tile_cells + 1;
+	static const sz points_per_tile = tile_points * tile_points * tile_points;
+
+	struct tile
+	{
+		flv data; //per type slot: points_per_tile values, then as many charge values
+		mutable std::atomic<bool> used;
+		tile(sz n) : data(n, 0), used(true) {}
+	};
+	class view;
+
+	const precalculate& p;
+	const grid& user_grid;
+	grid_dims gd;
+	fl slope;
+	grid geometry;
+	atomv receptor; //atoms within cutoff of the box
+	std::vector<smt> types;
+	szv slot; //slot of each atom type in a tile, max_sz if not needed
+	bool charged;
+	sz dims[3]; //grid points per dimension
+	sz ntiles[3];
+	sz memory_limit;
+
+	mutable std::vector<std::atomic<tile*> > tiles;
+	mutable std::atomic<sz> bytes;
+	mutable std::atomic<sz> computed;
+	mutable std::shared_mutex evict_lock;
+	mutable sz hand; //clock position, guarded by evict_lock
+
+	const tile& get(sz tx, sz ty, sz tz) const;
+	tile* compute(sz tx, sz ty, sz tz) const;
+	void evict() const;
+	fl eval_aux(const model& m, fl v, vecv* minus_forces) const;
+};
+
+#endif /* SMINA_LAZY_CACHE_H */
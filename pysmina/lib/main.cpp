@@ -16,8 +16,10 @@
 #include "common.h"
 #include "parse_pdbqt.h"
 #include "parallel_mc.h"
+#include "parallel.h"
 #include "file.h"
 #include "cache.h"
+#include "lazy_cache.h"
 #include "non_cache.h"
 #include "naive_non_cache.h"
 #include "non_cache_gpu.h"
@@ -37,6 +39,8 @@
 #include "coords.h"
 #include "obmolopener.h"
 #include "gpucode.h"
+#include "prepared_receptor.h"
+#include "SminaConverter.h"
 #include "precalculate_gpu.h"
 #include <boost/timer/timer.hpp>
 #include <boost/algorithm/string.hpp>
@@ -44,10 +48,12 @@
 #include "array3d.h"
 #include "grid.h"
 #include "molgetter.h"
+#include "smina_library.h"
 #include "result_info.h"
 #include "box.h"
 #include "flexinfo.h"
 #include "builtinscoring.h"
+#include "deadline.h"
 
 #include <boost/python.hpp>
 
@@ -68,17 +74,33 @@ struct user_settings
 	int verbosity;
 	int cpu;
 	int exhaustiveness;
+	sz early_term_hits;
+	unsigned early_term_patience;
+	bool adaptive_steps;
+	fl step_budget;
+	fl time_limit; //seconds per ligand, <= 0 for none
+	fl batch_time_limit; //seconds for all ligands, <= 0 for none
 	bool score_only;
 	bool randomize_only;
 	bool local_only;
 	bool dominimize;
 	bool include_atom_info;
+	bool flex_grids;
+	bool lazy_grid;
+	fl grid_memory; //MB of lazy grid tiles, <= 0 for no limit
+	fl coarse_granularity; //grid spacing for the MC phase, <= 0 to use the fine grid
+	bool heavy_search; //move only heavy atoms while searching
+	fl refine_prune_margin; //kcal/mol beyond energy_range not worth refining, <= 0 to refine all
 
 	//reasonable defaults
 	user_settings() : energy_range(2.0), num_modes(9), out_min_rmsd(1),
 					  forcecap(1000), seed(auto_seed()), verbosity(0), cpu(1), exhaustiveness(10),
+					  early_term_hits(0), early_term_patience(0), adaptive_steps(false), step_budget(1),
+					  time_limit(0), batch_time_limit(0),
 					  score_only(false), randomize_only(false), local_only(false),
-					  dominimize(false), include_atom_info(false)
+					  dominimize(false), include_atom_info(false), flex_grids(false),
+					  lazy_grid(false), grid_memory(0), coarse_granularity(0),
+					  heavy_search(false), refine_prune_margin(0)
 	{
 	}
 };
@@ -122,10 +144,10 @@ void write_all_output(model &m, const output_container &out, sz how_many,
 
 //set m to a random conformer
 fl do_randomization(model &m, const vec &corner1,
-					const vec &corner2, int seed, int verbosity, tee &log)
+					const vec &corner2, int seed, sz ligand_index, int verbosity, tee &log)
 {
 	conf init_conf = m.get_initial_conf();
-	rng generator(static_cast<rng::result_type>(seed));
+	rng generator = rng(static_cast<rng::result_type>(seed)).split(ligand_index);
 	if (verbosity > 1)
 	{
 		log << "Random seed: " << seed;
@@ -184,6 +206,59 @@ void refine_structure(model &m, const precalculate &prec, non_cache &nc,
 	nc.setSlope(slope_orig);
 }
 
+//refines, or rescores, the poses of out in parallel; refine_structure and
+//eval_adjusted both modify the model and non_cache, so every worker takes its
+//own copies and then pulls poses off a shared counter
+struct parallel_refine_aux
+{
+	const model *m;
+	const precalculate *prec;
+	const non_cache *nc;
+	const weighted_terms *sf;
+	output_container *out;
+	const vec *cap;
+	const minimization_params *minparm;
+	grid *user_grid;
+	bool rescore; //eval_adjusted instead of refine_structure
+	fl intramolecular_energy; //best mode's, for rescoring
+	mutable std::atomic<sz> next;
+
+	parallel_refine_aux(const model &m_, const precalculate &prec_, const non_cache &nc_,
+						const weighted_terms &sf_, output_container &out_, const vec &cap_,
+						const minimization_params &minparm_, grid &user_grid_)
+		: m(&m_), prec(&prec_), nc(&nc_), sf(&sf_), out(&out_), cap(&cap_), minparm(&minparm_),
+		  user_grid(&user_grid_), rescore(false), intramolecular_energy(0), next(0)
+	{
+	}
+
+	void operator()(sz) const
+	{
+		model wm = *m;
+		non_cache wnc = *nc;
+		for (sz i = next++; i < out->size(); i = next++)
+		{
+			output_type &o = (*out)[i];
+			if (!rescore)
+				refine_structure(wm, *prec, wnc, o, *cap, *minparm, *user_grid);
+			else if (not_max(o.e))
+				o.e = wm.eval_adjusted(*sf, *prec, wnc, *cap, o.c, intramolecular_energy, *user_grid);
+		}
+	}
+
+	void run(sz num_threads)
+	{
+		num_threads = (std::min)(num_threads, out->size());
+		next = 0;
+		if (num_threads <= 1)
+			(*this)(0);
+		else
+		{
+			parallel_for<parallel_refine_aux, true> pf(this, num_threads);
+			pf.run(num_threads);
+		}
+	}
+};
+
 std::string vina_remark(fl e, fl lb, fl ub)
 {
 	std::ostringstream remark;
@@ -203,13 +278,24 @@ output_container remove_redundant(const output_container &in, fl min_rmsd)
 	return tmp;
 }
 
+//score the flex residues of m with grids held in fc; non_cache adds the
+//user grid to every atom itself, so it is left out of these
+void populate_flex_grids(const model &m, const precalculate &prec, cache &fc, non_cache &nc)
+{
+	std::vector<smt> flex_types;
+	m.get_flex_atom_types(flex_types);
+	grid no_user_grid;
+	fc.populate(m, prec, flex_types, no_user_grid);
+	nc.set_flex_grids(&fc);
+}
+
 //dkoes - return all energies and rmsds to original conf with result
 void do_search(model &m, const boost::optional<model> &ref,
 			   const weighted_terms &sf, const precalculate &prec, const igrid &ig,
 			   non_cache &nc, // nc.slope is changed
 			   const vec &corner1, const vec &corner2,
 			   const parallel_mc &par, const user_settings &settings,
-			   bool compute_atominfo, tee &log,
+			   sz ligand_index, bool compute_atominfo, tee &log,
 			   const terms *customterms, grid &user_grid, std::vector<result_info> &results)
 {
 	boost::timer::cpu_timer time;
@@ -301,28 +387,58 @@ void do_search(model &m, const boost::optional<model> &ref,
 	}
 	else
 	{
-		rng generator(static_cast<rng::result_type>(settings.seed));
+		//stream keyed by (seed, ligand index) so a batch is reproducible however it is split up
+		rng generator = rng(static_cast<rng::result_type>(settings.seed)).split(ligand_index);
 		// log << "Using random seed: " << settings.seed;
 		// log.endl();
 		output_container out_cont;
 		// doing(settings.verbosity, "Performing search", log);
-		par(m, out_cont, prec, ig, corner1, corner2, generator, user_grid);
+		m.set_heavy_atoms_only(settings.heavy_search); //search and refinement copies inherit this
+		parallel_mc_stats stats = par(m, out_cont, prec, ig, corner1, corner2, generator, user_grid);
+		if (settings.verbosity > 1 || par.mc.adaptive_steps)
+		{
+			log << "MC steps used: " << stats.steps << " of " << par.num_tasks * par.mc.num_steps << " nominal";
+			log.endl();
+		}
+		if (stats.truncated)
+		{
+			//out of time; only refine what can make it into the output, with
+			//some room for poses that refinement makes redundant
+			log << "WARNING: time limit reached for " << m.get_name() << ", returning best poses found so far";
+			log.endl();
+			out_cont = remove_redundant(out_cont, settings.out_min_rmsd);
+			while (out_cont.size() > 2 * settings.num_modes)
+				out_cont.pop_back();
+		}
+		//optionally skip candidates well outside energy_range; refinement and
+		//rescoring can reorder poses, so this may change the results; energies
+		//from a coarse search grid are too rough to prune on
+		if (settings.refine_prune_margin > 0 && settings.coarse_granularity <= 0)
+		{
+			while (out_cont.size() > settings.num_modes && out_cont.back().e > out_cont.front().e + settings.energy_range + settings.refine_prune_margin)
+				out_cont.pop_back();
+		}
+
+		sz refine_threads = settings.cpu;
+#ifdef SMINA_GPU
+		if (dynamic_cast<non_cache_gpu *>(&nc)) //owns device memory, can't be copied
+			refine_threads = 1;
+#endif
 		// done(settings.verbosity, log);
 		// doing(settings.verbosity, "Refining results", log);
-		VINA_FOR_IN(i, out_cont)
-		refine_structure(m, prec, nc, out_cont[i], authentic_v,
-						 par.mc.ssd_par.minparm, user_grid);
+		parallel_refine_aux refiner(m, prec, nc, sf, out_cont, authentic_v,
+									par.mc.ssd_par.minparm, user_grid);
+		refiner.run(refine_threads);
+		//rescoring and output poses are set in full; model::eval's user grid
+		//term sums over hydrogens too
+		m.set_heavy_atoms_only(false);
 		if (!out_cont.empty())
 		{
 			out_cont.sort();
-			const fl best_mode_intramolecular_energy = m.eval_intramolecular(
+			refiner.intramolecular_energy = m.eval_intramolecular(
 				prec, authentic_v, out_cont[0].c);
-
-			VINA_FOR_IN(i, out_cont)
-			if (not_max(out_cont[i].e))
-				out_cont[i].e = m.eval_adjusted(sf, prec, nc, authentic_v,
-												out_cont[i].c, best_mode_intramolecular_energy,
-												user_grid);
+			refiner.rescore = true;
+			refiner.run(refine_threads);
 			// the order must not change because of non-decreasing g (see paper), but we'll re-sort in case g is non strictly increasing
 			out_cont.sort();
 		}
@@ -360,6 +476,7 @@ void do_search(model &m, const boost::optional<model> &ref,
 
 			//dkoes - setup result_info
 			results.push_back(result_info(out_cont[i].e, -1, lb, ub, m));
+			results.back().setTruncated(stats.truncated);
 			if (compute_atominfo)
 				results.back().setAtomValues(m, &sf);
 		}
@@ -398,10 +515,10 @@ void load_ent_values(const grid_dims &gd, std::istream &user_in,
 
 void main_procedure(model &m, precalculate &prec,
 					const boost::optional<model> &ref, // m is non-const (FIXME?)
-					const user_settings &settings,
+					const user_settings &settings, sz ligand_index,
 					bool no_cache, bool compute_atominfo, bool gpu_on,
 					const grid_dims &gd, minimization_params minparm,
-					const weighted_terms &wt, tee &log,
+					const weighted_terms &wt, const deadline &time_limit, tee &log,
 					std::vector<result_info> &results, grid &user_grid)
 {
 	doing(settings.verbosity, "Setting up the scoring function", log);
@@ -421,15 +538,27 @@ void main_procedure(model &m, precalculate &prec,
 	par.mc.min_rmsd = 1.0;
 	par.mc.num_saved_mins = settings.num_modes > 20 ? settings.num_modes : 20; //dkoes, support more than 20
 	par.mc.hunt_cap = vec(10, 10, 10);
+	par.mc.early_term_hits = settings.early_term_hits;
+	par.mc.early_term_patience = settings.early_term_patience;
+	par.mc.adaptive_steps = settings.adaptive_steps;
+	par.mc.step_budget = settings.step_budget;
 	par.num_tasks = settings.exhaustiveness;
 	par.num_threads = settings.cpu;
+	par.time_limit = time_limit;
 	par.display_progress = true;
 
+	std::vector<smt> present_types;
+	m.get_atom_types(present_types);
+	prec.prepare(present_types, settings.cpu);
+
 	szv_grid_cache gridcache(m, prec.cutoff_sqr());
 	const fl slope = 1e6; // FIXME: too large? used to be 100
+	//coarse to fine: the MC search runs on a coarser grid, the poses it
+	//finds are then minimized on the fine (non_cache) representation
+	const grid_dims search_gd = settings.coarse_granularity > 0 ? regrid(gd, settings.coarse_granularity) : gd;
 	if (settings.randomize_only)
 	{
-		fl e = do_randomization(m, corner1, corner2, settings.seed, settings.verbosity, log);
+		fl e = do_randomization(m, corner1, corner2, settings.seed, ligand_index, settings.verbosity, log);
 		results.push_back(result_info(e, -1, -1, -1, m));
 		return;
 	}
@@ -453,26 +582,52 @@ void main_procedure(model &m, precalculate &prec,
 		if (no_cache)
 		{
 			do_search(m, ref, wt, prec, *nc, *nc, corner1, corner2, par,
-					  settings, compute_atominfo, log,
+					  settings, ligand_index, compute_atominfo, log,
 					  wt.unweighted_terms(), user_grid,
 					  results);
 		}
+		else if (settings.lazy_grid && !(settings.score_only || settings.local_only))
+		{
+			std::vector<smt> atom_types_needed;
+			m.get_movable_atom_types(atom_types_needed);
+			sz memory_limit = settings.grid_memory > 0 ? sz(settings.grid_memory * 1024 * 1024) : 0;
+			lazy_cache lc(m, prec, search_gd, slope, atom_types_needed, user_grid, memory_limit);
+			cache fine("scoring_function_version001", gd, slope); //flex grids
+			if (settings.flex_grids && m.num_flex() > 0)
+				populate_flex_grids(m, prec, fine, *nc);
+			do_search(m, ref, wt, prec, lc, *nc, corner1, corner2, par,
+					  settings, ligand_index, compute_atominfo, log,
+					  wt.unweighted_terms(), user_grid, results);
+			if (settings.verbosity > 1)
+			{
+				log << "Grid tiles computed: " << lc.tiles_computed() << " of " << lc.tiles_total();
+				log.endl();
+			}
+		}
 		else
 		{
 			bool cache_needed = !(settings.score_only || settings.randomize_only || settings.local_only);
 			if (cache_needed)
 				doing(settings.verbosity, "Analyzing the binding site", log);
-			cache c("scoring_function_version001", gd, slope);
+			cache c("scoring_function_version001", search_gd, slope);
+			cache fine("scoring_function_version001", gd, slope); //flex grids when searching coarse
 			if (cache_needed)
 			{
 				std::vector<smt> atom_types_needed;
 				m.get_movable_atom_types(atom_types_needed);
 				c.populate(m, prec, atom_types_needed, user_grid);
 			}
+			if (settings.flex_grids && m.num_flex() > 0 && !settings.score_only)
+			{
+				//types already populated for the search are reused, unless
+				//those grids are coarse or have the user grid folded in
+				cache &fc = (settings.coarse_granularity > 0 || user_grid.initialized()) ? fine : c;
+				populate_flex_grids(m, prec, fc, *nc);
+			}
 			if (cache_needed)
 				done(settings.verbosity, log);
 			do_search(m, ref, wt, prec, c, *nc, corner1, corner2, par,
-					  settings, compute_atominfo, log,
+					  settings, ligand_index, compute_atominfo, log,
 					  wt.unweighted_terms(), user_grid, results);
 		}
 		delete nc;
@@ -727,6 +882,61 @@ std::istream &operator>>(std::istream &in, ApproxType &type)
 	return in;
 }
 
+//the scoring function and precalculate of the last run; the precalculated
+//tables only depend on the terms, weights, atom parameters and approximation,
+//so a run asking for the same ones (as repeated runs from python mostly do)
+//doesn't build them again
+struct scoring_setup
+{
+	std::string key;
+	custom_terms terms;
+	boost::shared_ptr<weighted_terms> wt;
+	boost::shared_ptr<precalculate> prec;
+};
+
+static boost::shared_ptr<scoring_setup> last_scoring;
+
+//the atom type data, which atom_constants can change
+static void atom_data_key(std::ostream &key)
+{
+	key << std::hexfloat;
+	VINA_FOR(i, smina_atom_type::NumTypes)
+	{
+		const smina_atom_type::info &info = smina_atom_type::data[i];
+		key << info.ad_radius << " " << info.ad_depth << " " << info.ad_solvation
+			<< " " << info.ad_volume << " " << info.covalent_radius << " "
+			<< info.xs_radius << " " << info.xs_hydrophobe << info.xs_donor
+			<< info.xs_acceptor << info.ad_heteroatom << "\n";
+	}
+}
+
+static std::string scoring_key(const custom_terms &terms, ApproxType approx,
+							   fl factor, bool gpu_on)
+{
+	std::stringstream key;
+	key << std::hexfloat << int(approx) << " " << factor << " " << gpu_on << "\n";
+	key << terms.specification();
+	atom_data_key(key);
+	return key.str();
+}
+
+//everything create_init_model's result depends on
+static std::string receptor_key(const std::string &rigid_name,
+								const std::string &flex_name, const std::string &flex_res,
+								double flex_dist, const std::string &flexdist_ligand)
+{
+	std::stringstream key;
+	key << std::hexfloat << boost::filesystem::extension(rigid_name) << " "
+		<< file_content_hash(rigid_name) << "\n";
+	key << file_content_hash(flex_name) << "\n";
+	key << flex_res << "\n";
+	key << flex_dist << " " << file_content_hash(flexdist_ligand) << "\n";
+	//the only global parse option; decides which hydrogens are mobile
+	key << get_fixed_rotable_hydrogens() << "\n";
+	atom_data_key(key);
+	return key.str();
+}
+
 #ifdef SMINA_GPU
 
 //set the default device to device and exit with error if there are any problems
@@ -779,15 +989,12 @@ static void create_init_model(const std::string &rigid_name,
 			{
 				throw usage_error("Cannot use -flex option with non-PDBQT receptor.");
 			}
-			ifile rigidin(rigid_name);
-			ifile flexin(flex_name);
-			initm = parse_receptor_pdbqt(rigid_name, rigidin, flex_name, flexin);
+			initm = parse_receptor_pdbqt(path(rigid_name), path(flex_name));
 		}
 		else if (!finfo.hasContent() && boost::filesystem::extension(rigid_name) == ".pdbqt")
 		{
 			//compatibility mode - read pdbqt directly with no openbabel shenanigans
-			ifile rigidin(rigid_name);
-			initm = parse_receptor_pdbqt(rigid_name, rigidin);
+			initm = parse_receptor_pdbqt(path(rigid_name));
 		}
 		else
 		{
@@ -795,9 +1002,6 @@ static void create_init_model(const std::string &rigid_name,
 			using namespace OpenBabel;
 			obmol_opener fileopener;
 			OBConversion conv;
-			conv.SetOutFormat("PDBQT");
-			conv.AddOption("r", OBConversion::OUTOPTIONS); //rigid molecule, otherwise really slow and useless analysis is triggered
-			conv.AddOption("c", OBConversion::OUTOPTIONS); //single combined molecule
 			fileopener.openForInput(conv, rigid_name);
 			OBMol rec;
 			if (!conv.Read(&rec))
@@ -809,22 +1013,12 @@ static void create_init_model(const std::string &rigid_name,
 				a->GetPartialCharge();
 			}
 			OBMol rigid;
-			std::string flexstr;
+			std::vector<OBMol> flex;
 			finfo.sanitizeFlexres(rec);
-			finfo.extractFlex(rec, rigid, flexstr);
+			finfo.extractFlex(rec, rigid, flex);
 
-			std::string recstr = conv.WriteString(&rigid);
-			std::stringstream recstream(recstr);
-
-			if (flexstr.size() > 0) //have flexible component
-			{
-				std::stringstream flexstream(flexstr);
-				initm = parse_receptor_pdbqt(rigid_name, recstream, flex_name, flexstream);
-			}
-			else //rigid only
-			{
-				initm = parse_receptor_pdbqt(rigid_name, recstream);
-			}
+			//straight to the model, rather than writing pdbqt text to parse
+			initm = SminaConverter::convertReceptor(rigid, flex);
 		}
 	}
 }
@@ -851,6 +1045,8 @@ std::string run(python::dict &ns)
 		fl autobox_add = 4;
 		std::string autobox_ligand;
 		std::string flexdist_ligand;
+		std::string receptor_cache;
+		sz shard = 0, num_shards = 1;
 		std::string builtin_scoring;
 		int device = 0;
 		// fl weight_gauss1 = -0.035579;
@@ -884,7 +1080,10 @@ std::string run(python::dict &ns)
 																						   "ligand(s)")("flexres", value<std::string>(&flex_res),
 																										"flexible side chains specified by comma separated list of chain:resid or chain:resid:icode")("flexdist_ligand", value<std::string>(&flexdist_ligand),
 																																																	  "Ligand to use for flexdist")("flexdist", value<double>(&flex_dist),
-																																																									"set all side chains within specified distance to flexdist_ligand to flexible");
+																																																									"set all side chains within specified distance to flexdist_ligand to flexible")("receptor_cache", value<std::string>(&receptor_cache),
+"prepared receptor file: loaded if it was prepared from the same receptor and flexible residue options, otherwise written after preparing the receptor")("shard", value<sz>(&shard)->default_value(0),
+"dock only this shard of the ligands (0 based); needs indexed .smina libraries")("num_shards", value<sz>(&num_shards)->default_value(1),
+"number of shards the ligands are split into, e.g. one per process");
 
 		//options_description search_area("Search area (required, except with --score_only)");
 		options_description search_area("Search space (required)");
@@ -929,7 +1128,19 @@ std::string run(python::dict &ns)
 																																																																	   "maximum number of binding modes to generate")("energy_range", value<fl>(&settings.energy_range)->default_value(3.0),
 																																																																													  "maximum energy difference between the best binding mode and the worst one displayed (kcal/mol)")("min_rmsd_filter", value<fl>(&settings.out_min_rmsd)->default_value(1.0),
 																																																																																																						"rmsd value used to filter final poses to remove redundancy")("quiet,q", bool_switch(&quiet), "Suppress output messages")("addH", value<bool>(&add_hydrogens),
-																																																																																																																																				  "automatically add hydrogens in ligands (on by default)")
+																																																																																																																																				  "automatically add hydrogens in ligands (on by default)")("early_term_hits", value<sz>(&settings.early_term_hits)->default_value(0),
+									"stop the search once this many MC tasks have rediscovered the best pose (0 = off, results become timing dependent)")("early_term_patience", value<unsigned>(&settings.early_term_patience)->default_value(0),
+									"stop an MC task after this many steps without any task improving the best pose (0 = off, results become timing dependent)")("adaptive_steps", bool_switch(&settings.adaptive_steps),
+									"cut MC chains that stop improving and extend the ones that still improve (results become timing dependent)")("step_budget", value<fl>(&settings.step_budget)->default_value(1.0),
+									"with adaptive_steps, total MC steps allowed per ligand as a multiple of the default heuristic")("time_limit", value<fl>(&settings.time_limit)->default_value(0),
+									"wall-clock seconds allowed per ligand search; best poses so far are returned and flagged searchTruncated (0 = no limit)")("batch_time_limit", value<fl>(&settings.batch_time_limit)->default_value(0),
+									"wall-clock seconds allowed for all ligands together (0 = no limit)")("flex_grids", bool_switch(&settings.flex_grids),
+"score flexible side chains against the rigid receptor with precomputed grids during local optimization (faster, less exact)")("lazy_grid", bool_switch(&settings.lazy_grid),
+"compute the search grid in tiles as the search reaches them instead of up front (for large boxes)")("grid_memory", value<fl>(&settings.grid_memory)->default_value(0),
+"with lazy_grid, approximate limit in MB on grid tile memory; tiles not used recently are dropped (0 = no limit)")("coarse_grid", value<fl>(&settings.coarse_granularity)->default_value(0),
+"grid spacing in Angstroms for the Monte Carlo search, e.g. 0.75 or 1.0; poses are refined with the exact scoring as usual (0 = use the standard 0.375 grid)")("heavy_search", bool_switch(&settings.heavy_search),
+"move only heavy atoms during the search and place hydrogens when poses are output (for scoring functions that ignore hydrogens)")("refine_prune", value<fl>(&settings.refine_prune_margin)->default_value(0),
+"skip refining poses more than this many kcal/mol beyond energy_range from the best (faster, may change results; 0 = refine all)")
 #ifdef SMINA_GPU
 			("device", value<int>(&device)->default_value(0), "GPU device to use")("gpu", bool_switch(&gpu_on), "Turn on GPU acceleration")
 #endif
@@ -1026,6 +1237,18 @@ std::string run(python::dict &ns)
 			return "";
 		}
 
+		if (num_shards < 1 || shard >= num_shards)
+			throw usage_error("shard must be less than num_shards");
+		if (num_shards > 1)
+		{
+			for (unsigned l = 0, nl = ligand_names.size(); l < nl; l++)
+			{
+				if (!smina_library::is_library(ligand_names[l]))
+					throw usage_error("Sharding needs indexed .smina libraries, "
+							+ ligand_names[l] + " is not one");
+			}
+		}
+
 		if (settings.exhaustiveness < 1)
 			throw usage_error("exhaustiveness must be 1 or greater");
 		if (settings.num_modes < 1)
@@ -1068,7 +1291,8 @@ std::string run(python::dict &ns)
 		flv weights;
 
 		//dkoes, set the scoring function
-		custom_terms customterms;
+		boost::shared_ptr<scoring_setup> scoring(new scoring_setup);
+		custom_terms &customterms = scoring->terms;
 		if (user_grid_lambda != -1.0)
 		{
 			customterms.set_scaling_factor(user_grid_lambda);
@@ -1089,12 +1313,7 @@ std::string run(python::dict &ns)
 		}
 		else
 		{
-			customterms.add("gauss(o=0,_w=0.5,_c=8)", -0.035579);
-			customterms.add("gauss(o=3,_w=2,_c=8)", -0.005156);
-			customterms.add("repulsion(o=0,_c=8)", 0.840245);
-			customterms.add("hydrophobic(g=0.5,_b=1.5,_c=8)", -0.035069);
-			customterms.add("non_dir_h_bond(g=-0.7,_b=0,_c=8)", -0.587439);
-			customterms.add("num_tors_div", 5 * 0.05846 / 0.1 - 1);
+			builtin_scoring_functions.set(customterms, "default");
 		}
 
 		if (usergrid_file_name.size() > 0)
@@ -1148,28 +1367,54 @@ std::string run(python::dict &ns)
 		//dkoes - parse in receptor once
 		model initm;
 
-		create_init_model(rigid_name, flex_name, finfo, initm, log);
+		if (receptor_cache.size() > 0 && rigid_name.size() > 0)
+		{
+			std::string rkey = receptor_key(rigid_name, flex_name, flex_res,
+											flex_dist, flexdist_ligand);
+			if (!load_prepared_receptor(receptor_cache, rkey, initm))
+			{
+				create_init_model(rigid_name, flex_name, finfo, initm, log);
+				if (!save_prepared_receptor(receptor_cache, rkey, initm))
+				{
+					log << "WARNING: could not write prepared receptor " << receptor_cache;
+					log.endl();
+				}
+			}
+			else if (settings.verbosity > 1)
+				log << "Using prepared receptor " << receptor_cache << "\n";
+		}
+		else
+			create_init_model(rigid_name, flex_name, finfo, initm, log);
 
 		//dkoes, hoist precalculation outside of loop
-		weighted_terms wt(&customterms, customterms.weights());
-
-		boost::shared_ptr<precalculate> prec;
+		std::string key = scoring_key(customterms, approx, approx_factor, gpu_on);
+		if (!last_scoring || last_scoring->key != key)
+		{
+			scoring->key = key;
+			scoring->wt.reset(new weighted_terms(&customterms, customterms.weights()));
+			const weighted_terms &wt = *scoring->wt;
+			boost::shared_ptr<precalculate> &prec = scoring->prec;
 
-		if (gpu_on || approx == GPU)
-		{ //don't get a choice
+			if (gpu_on || approx == GPU)
+			{ //don't get a choice
 #ifdef SMINA_GPU
-			prec = boost::shared_ptr<precalculate>(new precalculate_gpu(wt, approx_factor));
+				prec = boost::shared_ptr<precalculate>(new precalculate_gpu(wt, approx_factor));
 #endif
+			}
+			else if (approx == SplineApprox)
+				prec = boost::shared_ptr<precalculate>(
+					new precalculate_splines(wt, approx_factor));
+			else if (approx == LinearApprox)
+				prec = boost::shared_ptr<precalculate>(
+					new precalculate_linear(wt, approx_factor));
+			else if (approx == Exact)
+				prec = boost::shared_ptr<precalculate>(
+					new precalculate_exact(wt));
+			last_scoring = scoring;
 		}
-		else if (approx == SplineApprox)
-			prec = boost::shared_ptr<precalculate>(
-				new precalculate_splines(wt, approx_factor));
-		else if (approx == LinearApprox)
-			prec = boost::shared_ptr<precalculate>(
-				new precalculate_linear(wt, approx_factor));
-		else if (approx == Exact)
-			prec = boost::shared_ptr<precalculate>(
-				new precalculate_exact(wt));
+		//the same terms as customterms
+		const weighted_terms &wt = *last_scoring->wt;
+		boost::shared_ptr<precalculate> prec = last_scoring->prec;
 
 		//setup single outfile
 		using namespace OpenBabel;
@@ -1197,7 +1442,9 @@ std::string run(python::dict &ns)
 		}
 
 		boost::timer::cpu_timer time;
-		MolGetter mols(initm, add_hydrogens);
+		MolGetter mols(initm, add_hydrogens, shard, num_shards);
+		sz ligand_index = 0; //position in the whole batch, keys the random stream
+		const deadline batch_deadline = deadline::after(settings.batch_time_limit);
 
 		//loop over input ligands
 		for (unsigned l = 0, nl = ligand_names.size(); l < nl; l++)
@@ -1205,6 +1452,7 @@ std::string run(python::dict &ns)
 			doing(settings.verbosity, "Reading input", log);
 			const std::string &ligand_name = ligand_names[l];
 			mols.setInputFile(ligand_name);
+			const sz file_base = ligand_index;
 
 			//process input molecules one at a time
 			unsigned i = 0;
@@ -1225,12 +1473,17 @@ std::string run(python::dict &ns)
 				boost::optional<model> ref;
 				done(settings.verbosity, log);
 
+				if (mols.indexed()) //same stream for a molecule whichever shard docks it
+					ligand_index = file_base + mols.libraryIndex();
+
 				std::vector<result_info> results;
 
-				main_procedure(m, *prec, ref, settings,
+				main_procedure(m, *prec, ref, settings, ligand_index,
 							   false, // no_cache == false
 							   atomoutfile.is_open() || settings.include_atom_info, gpu_on,
-							   gd, minparms, wt, log, results, user_grid);
+							   gd, minparms, wt,
+							   deadline::after(settings.time_limit).earliest(batch_deadline),
+							   log, results, user_grid);
 				// results;
 				//write out molecular data
 				for (unsigned j = 0, nr = results.size(); j < nr; j++)
@@ -1253,7 +1506,10 @@ std::string run(python::dict &ns)
 					}
 				}
 				i++;
+				ligand_index++;
 			}
+			if (mols.indexed())
+				ligand_index = file_base + mols.librarySize();
 		}
 	}
 	catch (file_error &e)
@@ -1311,8 +1567,128 @@ std::string run(python::dict &ns)
 	return output_stream.str();
 }
 
+//indexed .smina libraries; errors are raised as python exceptions so a
+//parallel build can tell a shard failed
+static std::runtime_error library_error(const path &name, const std::string &what)
+{
+	return std::runtime_error(what + " \"" + name.string() + "\"");
+}
+
+int build_library(const std::string &input, const std::string &output,
+				  int shard, int num_shards, bool metadata, int size)
+{
+	if (num_shards < 1 || shard < 0 || shard >= num_shards)
+		throw std::runtime_error("shard must be less than num_shards");
+	boost::optional<sz> count;
+	if (size >= 0)
+		count = sz(size);
+	try
+	{
+		return build_smina_library(input, path(output), shard, num_shards,
+								   metadata, count);
+	}
+	catch (file_error &e)
+	{
+		throw library_error(e.name, e.in ? "could not read" : "could not write");
+	}
+	catch (parse_error &e)
+	{
+		throw library_error(e.file, e.reason + " in");
+	}
+}
+
+int count_library_molecules(const std::string &input)
+{
+	try
+	{
+		return count_library_input(input);
+	}
+	catch (file_error &e)
+	{
+		throw library_error(e.name, "could not read");
+	}
+}
+
+int merge_libraries(python::list &inputs, const std::string &output)
+{
+	try
+	{
+		return merge_smina_libraries(pyListToVect(inputs), path(output));
+	}
+	catch (file_error &e)
+	{
+		throw library_error(e.name, e.in ? "could not read" : "could not write");
+	}
+	catch (parse_error &e)
+	{
+		throw library_error(e.file, e.reason + " in");
+	}
+}
+
+python::list library_metadata(const std::string &name)
+{
+	python::list ret;
+	try
+	{
+		smina_library lib(name);
+		if (lib.has_metadata())
+		{
+			for (sz i = 0, n = lib.size(); i < n; i++)
+			{
+				const library_entry &e = lib.entry(i);
+				ret.append(python::make_tuple(e.name, e.heavy_atoms, e.torsions));
+			}
+		}
+	}
+	catch (file_error &e)
+	{
+		throw library_error(e.name, "could not read");
+	}
+	catch (parse_error &e)
+	{
+		throw library_error(e.file, e.reason + " in");
+	}
+	return ret;
+}
+
+int library_size(const std::string &name)
+{
+	try
+	{
+		return smina_library(name).size();
+	}
+	catch (file_error &e)
+	{
+		throw library_error(e.name, "could not read");
+	}
+	catch (parse_error &e)
+	{
+		throw library_error(e.file, e.reason + " in");
+	}
+}
+
 BOOST_PYTHON_MODULE(sminalib)
 {
+	python::def("build_library", &build_library,
+				(python::arg("input"), python::arg("output"), python::arg("shard") = 0,
+				 python::arg("num_shards") = 1, python::arg("metadata") = true,
+				 python::arg("size") = -1),
+				"Convert a shard of the molecules in input (sdf or any format openbabel reads)\n\
+into an indexed .smina library at output. The molecules are split into num_shards\n\
+contiguous shards, so building every shard in its own process and merging the\n\
+results in shard order gives the molecules in file order. size is\n\
+count_molecules(input); pass it so the shard jobs don't each count the input.\n\
+Returns the number of molecules written.");
+	python::def("count_molecules", &count_library_molecules, (python::arg("input")),
+				"Number of molecules build_library splits input into shards over.");
+	python::def("merge_libraries", &merge_libraries,
+				(python::arg("inputs"), python::arg("output")),
+				"Concatenate indexed .smina libraries in order. Returns the number of molecules.");
+	python::def("library_size", &library_size, (python::arg("library")),
+				"Number of molecules in an indexed .smina library.");
+	python::def("library_metadata", &library_metadata, (python::arg("library")),
+				"(name, heavy atoms, torsions) of each molecule of an indexed .smina library,\n\
+empty if it was built without metadata.");
 
 	python::def("run", &run, "<br/>\
 <h2>Reproduce smina binary:</h2>\
@@ -0,0 +1,115 @@
+/*
+ * mc_board.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "mc_board.h"
+#include "coords.h"
+
+mc_board::mc_board(sz num_slots, fl min_rmsd_, sz hits_needed_, long spare_steps_, const deadline& time_limit_, fl energy_tolerance_) :
+		slots(num_slots), best_e(max_fl), generation(0), hits(0), readers(0), spare_steps(spare_steps_),
+				time_limit(time_limit_), truncated(false), min_rmsd(min_rmsd_),
+				energy_tolerance(energy_tolerance_), hits_needed(hits_needed_)
+{
+}
+
+mc_board::~mc_board()
+{
+	VINA_FOR_IN(i, slots)
+	{
+		VINA_FOR_IN(j, slots[i].retired)
+			delete slots[i].retired[j];
+		delete slots[i].coords.load(std::memory_order_relaxed);
+	}
+}
+
+bool mc_board::take_steps(unsigned n)
+{
+	long cur = spare_steps.load(std::memory_order_relaxed);
+	while (cur >= long(n))
+	{
+		if (spare_steps.compare_exchange_weak(cur, cur - long(n), std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+sz mc_board::best_slot() const
+{
+	sz ret = slots.size();
+	fl e = max_fl;
+	VINA_FOR_IN(i, slots)
+	{
+		fl se = slots[i].e.load(std::memory_order_acquire);
+		if (se < e)
+		{
+			e = se;
+			ret = i;
+		}
+	}
+	return ret;
+}
+
+void mc_board::publish(sz slot_index, fl e, const vecv& coords)
+{
+	assert(slot_index < slots.size());
+
+	slot& s = slots[slot_index];
+
+	//did another task already find this?  only count poses from other slots,
+	//a chain revisiting its own minimum says nothing about convergence, and
+	//each slot counts at most once until the best improves
+	unsigned gen = generation.load(std::memory_order_acquire);
+	if (s.hit_generation != gen)
+	{
+		readers.fetch_add(1);
+		sz b = best_slot();
+		if (b < slots.size() && b != slot_index)
+		{
+			const vecv *bc = slots[b].coords.load();
+			if (bc && e <= slots[b].e.load(std::memory_order_relaxed) + energy_tolerance
+					&& rmsd_upper_bound(coords, *bc, min_rmsd) < min_rmsd)
+			{
+				s.hit_generation = gen;
+				hits.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		readers.fetch_sub(1);
+	}
+
+	if (e >= s.e.load(std::memory_order_relaxed))
+		return;
+
+	//pose goes in before the energy so a reader never pairs a new energy with a stale pose
+	const vecv *old = s.coords.exchange(new vecv(coords));
+	s.e.store(e, std::memory_order_release);
+	if (old)
+		s.retired.push_back(old);
+
+	//a reader that starts after the exchange can only see the new pose, so
+	//with nobody reading now the replaced ones are unreachable
+	if (!s.retired.empty() && readers.load() == 0)
+	{
+		VINA_FOR_IN(i, s.retired)
+			delete s.retired[i];
+		s.retired.clear();
+	}
+
+	fl cur = best_e.load(std::memory_order_relaxed);
+	while (e < cur)
+	{
+		if (best_e.compare_exchange_weak(cur, e, std::memory_order_acq_rel))
+		{
+			//only a genuinely better pose restarts the rediscovery count and
+			//counts as progress; the generation moves first so a hit racing
+			//with the reset is lost rather than carried over
+			if (cur - e > energy_tolerance)
+			{
+				generation.fetch_add(1, std::memory_order_acq_rel);
+				hits.store(0, std::memory_order_relaxed);
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * mc_board.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_MC_BOARD_H
+#define SMINA_MC_BOARD_H
+
+#include <atomic>
+#include "common.h"
+#include "deadline.h"
+
+// Best-pose board shared by the monte_carlo tasks of one parallel_mc run,
+// together with the step pool used by the adaptive step budget and the
+// run's wall-clock deadline.
+// Every task owns one slot and is its only writer, so publishing never
+// takes a lock: a slot's pose is an immutable copy swapped in through an
+// atomic pointer.  Replaced copies are retired and freed by the writer the
+// next time no task is reading any slot.  Other tasks read the slots to
+// decide whether the search as a whole has converged.
+//
+// Early termination makes results depend on task timing, so it is opt-in.
+class mc_board
+{
+	struct slot
+	{
+		std::atomic<fl> e;
+		std::atomic<const vecv*> coords;
+		std::vector<const vecv*> retired; //owned by the writer
+		unsigned hit_generation; //owned by the writer, last generation this slot counted a hit in
+		slot() : e(max_fl), coords(NULL), hit_generation(unsigned(-1)) {}
+	};
+
+	std::vector<slot> slots;
+	std::atomic<fl> best_e;
+	std::atomic<unsigned> generation; //bumped whenever best_e improves
+	std::atomic<sz> hits; //slots that have rediscovered the current best
+	std::atomic<unsigned> readers; //tasks currently looking at another slot's pose
+	std::atomic<long> spare_steps; //adaptive mode: steps left over for extending chains
+	deadline time_limit;
+	std::atomic<bool> truncated; //some task was stopped by the deadline
+	fl min_rmsd;
+	fl energy_tolerance;
+	sz hits_needed;
+
+	sz best_slot() const;
+
+public:
+	mc_board(sz num_slots, fl min_rmsd_, sz hits_needed_, long spare_steps_ = 0, const deadline& time_limit_ = deadline(), fl energy_tolerance_ = 0.1);
+	~mc_board();
+
+	// called by the owner of slot with every refined local minimum
+	void publish(sz slot_index, fl e, const vecv& coords);
+
+	unsigned get_generation() const { return generation.load(std::memory_order_acquire); }
+	fl get_best_energy() const { return best_e.load(std::memory_order_acquire); }
+
+	// adaptive mode step pool; take_steps either grants all n or nothing
+	bool take_steps(unsigned n);
+	void return_steps(unsigned n) { spare_steps.fetch_add(n, std::memory_order_relaxed); }
+
+	// true once the deadline has passed; remembers that the search was cut short
+	bool expired()
+	{
+		if (!time_limit.passed())
+			return false;
+		truncated.store(true, std::memory_order_relaxed);
+		return true;
+	}
+	bool was_truncated() const { return truncated.load(std::memory_order_relaxed); }
+
+	// the best pose has been found independently by hits_needed other tasks,
+	// each counted once per generation
+	bool converged() const { return hits_needed > 0 && hits.load(std::memory_order_relaxed) >= hits_needed; }
+};
+
+#endif /* SMINA_MC_BOARD_H */
@@ -642,6 +642,19 @@ sz model::num_internal_pairs() const
 	return tmp;
 }
 
+void model::get_flex_atom_types(std::vector<smt>& flextypes) const
+		{
+	sz n = num_atom_types();
+	flextypes.clear();
+	VINA_FOR(i, m_num_movable_atoms)
+	{
+		smt t = atoms[i].get();
+		if (t < n && !is_hydrogen(t) && find_ligand(i) == ligands.size()
+				&& !has(flextypes, t))
+			flextypes.push_back(t);
+	}
+}
+
 void model::get_movable_atom_types(std::vector<smt>& movingtypes) const
 		{
 	sz n = num_atom_types();
@@ -656,6 +669,22 @@ void model::get_movable_atom_types(std::vector<smt>& movingtypes) const
 	}
 }
 
+void model::get_atom_types(std::vector<smt>& types) const
+		{
+	sz n = num_atom_types();
+	std::vector<bool> seen(n, false);
+	types.clear();
+	VINA_FOR_IN(i, atoms)
+		if (atoms[i].get() < n)
+			seen[atoms[i].get()] = true;
+	VINA_FOR_IN(i, grid_atoms)
+		if (grid_atoms[i].get() < n)
+			seen[grid_atoms[i].get()] = true;
+	VINA_FOR(t, n)
+		if (seen[t])
+			types.push_back(smt(t));
+}
+
 conf_size model::get_size() const
 {
 	conf_size tmp;
@@ -836,8 +865,37 @@ void model::sete(const conf& c)
 
 void model::set(const conf& c)
 {
-	ligands.set_conf(atoms, coords, c.ligands);
-	flex.set_conf(atoms, coords, c.flex);
+	update_kinematics();
+	if (!grid_groups.current(atoms.size()))
+		grid_groups.build(atoms, m_num_movable_atoms);
+	kinematics.set_conf(c, coords, heavy_atoms_only);
+	hydrogens_stale = heavy_atoms_only;
+	VINA_FOR_IN(i, ligands)
+		kinematics.write_root(i, ligands[i].node);
+	VINA_FOR_IN(i, flex)
+		kinematics.write_root(ligands.size() + i, flex[i].node);
+}
+
+void model::set_hydrogens()
+{
+	if (!hydrogens_stale)
+		return;
+	VINA_CHECK(kinematics.current(atoms.size(), ligands.size(), flex.size()));
+	kinematics.set_hydrogens(coords);
+	hydrogens_stale = false;
+}
+
+//flatten the ligand and flex torsion trees if they changed
+void model::update_kinematics()
+{
+	if (kinematics.current(atoms.size(), ligands.size(), flex.size()))
+		return;
+	kinematics.clear();
+	VINA_FOR_IN(i, ligands)
+		kinematics.add(ligands[i]);
+	VINA_FOR_IN(i, flex)
+		kinematics.add(flex[i]);
+	kinematics.finish(atoms);
 }
 
 //dkoes - return the string corresponding to i'th ligand atoms pdb information
@@ -927,6 +985,55 @@ fl model::eval_interacting_pairs_deriv(const precalculate& p, fl v,
 	return e;
 }
 
+//use the compiled plan when it is current for p, else the pairs themselves
+fl model::eval_pairs(const precalculate& p, fl v,
+		const interacting_pairs& pairs, const pair_plan* plan,
+		const vecv& coords) const
+{
+	if (plan && plan->usable && plan->compiled_for(p.serial(), atoms.size()))
+		return p.eval_plan(*plan, v, coords);
+	return eval_interacting_pairs(p, v, pairs, coords);
+}
+
+fl model::eval_pairs_deriv(const precalculate& p, fl v,
+		const interacting_pairs& pairs, const pair_plan* plan,
+		const vecv& coords, vecv& forces) const
+{
+	if (plan && plan->usable && plan->compiled_for(p.serial(), atoms.size()))
+		return p.eval_plan_deriv(*plan, v, coords, forces);
+	return eval_interacting_pairs_deriv(p, v, pairs, coords, forces);
+}
+
+static void compile_pair_plan(const precalculate& p, const atomv& atoms,
+		const interacting_pairs& pairs, pair_plan& plan)
+{
+	plan.clear();
+	plan.usable = true;
+	VINA_FOR_IN(i, pairs)
+	{
+		const interacting_pair& ip = pairs[i];
+		if (!p.add_to_plan(atoms[ip.a], atoms[ip.b], ip.a, ip.b, plan))
+		{
+			plan.clear(); //not supported, evaluate the pairs directly
+			break;
+		}
+	}
+	plan.serial = p.serial();
+	plan.built_for = atoms.size();
+}
+
+//make sure the per-ligand and other pair plans are compiled against p
+void model::update_pair_plans(const precalculate& p)
+{
+	if (ligand_plans.size() == ligands.size()
+			&& other_plan.compiled_for(p.serial(), atoms.size()))
+		return;
+	ligand_plans.resize(ligands.size());
+	VINA_FOR_IN(i, ligands)
+		compile_pair_plan(p, atoms, ligands[i].pairs, ligand_plans[i]);
+	compile_pair_plan(p, atoms, other_pairs, other_plan);
+}
+
 fl model::evali(const precalculate& p, const vec& v) const
 		{ // clean up
 	fl e = 0;
@@ -938,7 +1045,7 @@ fl model::evali(const precalculate& p, const vec& v) const
 fl model::evale(const precalculate& p, const igrid& ig, const vec& v) const
 		{ // clean up
 	fl e = ig.eval(*this, v[1]);
-	e += eval_interacting_pairs(p, v[2], other_pairs, coords);
+	e += eval_pairs(p, v[2], other_pairs, &other_plan, coords);
 	return e;
 }
 
@@ -946,9 +1053,10 @@ fl model::eval(const precalculate& p, const igrid& ig, const vec& v,
 		const conf& c, const grid& user_grid)
 { // clean up
 	set(c);
+	update_pair_plans(p);
 	fl e = evale(p, ig, v);
 	VINA_FOR_IN(i, ligands)
-		e += eval_interacting_pairs(p, v[0], ligands[i].pairs, coords); // coords instead of internal coords
+		e += eval_pairs(p, v[0], ligands[i].pairs, ligand_plan(i), coords); // coords instead of internal coords
 	//std::cout << "smina_contribution: " << e << "\n";
 	if(user_grid.initialized())
 	{
@@ -970,56 +1078,77 @@ fl model::eval_deriv(const precalculate& p, const igrid& ig, const vec& v,
 		const conf& c, change& g, const grid& user_grid)
 { // clean up
 	set(c);
+	update_pair_plans(p);
 	fl e = ig.eval_deriv(*this, v[1], user_grid); // sets minus_forces, except inflex
-	e += eval_interacting_pairs_deriv(p, v[2], other_pairs, coords,
+	e += eval_pairs_deriv(p, v[2], other_pairs, &other_plan, coords,
 			minus_forces); // adds to minus_forces
 	VINA_FOR_IN(i, ligands)
-		e += eval_interacting_pairs_deriv(p, v[0], ligands[i].pairs, coords,
-				minus_forces); // adds to minus_forces
-	// calculate derivatives
-	ligands.derivative(coords, minus_forces, g.ligands);
-	flex.derivative(coords, minus_forces, g.flex); // inflex forces are ignored
+		e += eval_pairs_deriv(p, v[0], ligands[i].pairs, ligand_plan(i),
+				coords, minus_forces); // adds to minus_forces
+	// calculate derivatives, from the frames set(c) left in kinematics
+	kinematics.derivative(coords, minus_forces, g, heavy_atoms_only); // inflex forces are ignored
 	return e;
 }
 
+//make sure the receptor cell list and the flex atom/pair lists used for
+//flex-rigid and flex-flex scoring are current
+void model::update_flex_rigid(fl cutoff_sqr)
+{
+	sz nat = num_atom_types();
+	if (!rigid_index || !rigid_index->matches(grid_atoms, cutoff_sqr))
+		rigid_index.reset(new rigid_cells(grid_atoms, cutoff_sqr, nat));
+
+	if (flex_rigid_built_for == atoms.size())
+		return;
+
+	flex_rigid_atoms.clear();
+	num_movable_flex_rigid = 0;
+	VINA_FOR_IN(i, atoms)
+	{
+		if (find_ligand(i) < ligands.size() || atoms[i].get() >= nat)
+			continue;
+		flex_rigid_atoms.push_back(i);
+		if (i < m_num_movable_atoms)
+			num_movable_flex_rigid++;
+	}
+
+	flex_flex_pairs.clear();
+	VINA_FOR_IN(i, other_pairs)
+	{
+		const interacting_pair& pair = other_pairs[i];
+		if (find_ligand(pair.a) >= ligands.size()
+				&& find_ligand(pair.b) >= ligands.size())
+			flex_flex_pairs.push_back(pair);
+	}
+	flex_rigid_built_for = atoms.size();
+}
+
 //evaluate interactiongs between all of flex (including rigid) and protein
 //will ignore grid_atoms greater than max
 fl model::eval_flex(const precalculate& p, const vec& v, const conf& c, unsigned maxGridAtom)
 {
 	set(c);
 	fl e = 0;
-	sz nat = num_atom_types();
-	const fl cutoff_sqr = p.cutoff_sqr();
+	update_flex_rigid(p.cutoff_sqr());
 
 	//ignore atoms after maxGridAtom (presumably part of "unfrag")
 	sz gridstop = grid_atoms.size();
 	if(maxGridAtom > 0 && maxGridAtom < gridstop) gridstop = maxGridAtom;
 
-	// flex-rigid
-	VINA_FOR(i, atoms.size())
+	// flex-rigid; hydrogens left behind by a heavy atom only set are skipped
+	VINA_FOR_IN(k, flex_rigid_atoms)
 	{
-		if (find_ligand(i) < ligands.size())
-			continue; // we only want flex-rigid interaction
-		const atom& a = atoms[i];
-		smt t1 = a.get();
-		if (t1 >= nat)
+		const atom& a = atoms[flex_rigid_atoms[k]];
+		if (hydrogens_stale && a.is_hydrogen())
 			continue;
-		VINA_FOR_IN(j, grid_atoms)
-		{
-			if(j >= gridstop)
-				break;
-			const atom& b = grid_atoms[j];
-			smt t2 = b.get();
-			if (t2 >= nat)
-				continue;
-			fl r2 = vec_distance_sqr(coords[i], b.coords);
-			if (r2 < cutoff_sqr)
-			{
-				fl this_e = p.eval(a, b, r2);
-				curl(this_e, v[1]);
-				e += this_e;
-			}
-		}
+		rigid_index->for_each_near(coords[flex_rigid_atoms[k]],
+				[&](sz j, fl r2) {
+					if (j >= gridstop)
+						return;
+					fl this_e = p.eval(a, grid_atoms[j], r2);
+					curl(this_e, v[1]);
+					e += this_e;
+				});
 	}
 
 	return e;
@@ -1033,44 +1162,33 @@ fl model::eval_intramolecular(const precalculate& p, const vec& v,
 
 	// internal for each ligand
 	VINA_FOR_IN(i, ligands)
-		e += eval_interacting_pairs(p, v[0], ligands[i].pairs, coords); // coords instead of internal coords
+		e += eval_pairs(p, v[0], ligands[i].pairs, ligand_plan(i), coords); // coords instead of internal coords
 
-	sz nat = num_atom_types();
 	const fl cutoff_sqr = p.cutoff_sqr();
+	update_flex_rigid(cutoff_sqr);
 
-	// flex-rigid
-	VINA_FOR(i, num_movable_atoms())
+	// flex-rigid, movable atoms only; hydrogens left behind by a heavy atom
+	// only set are skipped, here and for flex-flex
+	VINA_FOR(k, num_movable_flex_rigid)
 	{
-		if (find_ligand(i) < ligands.size())
-			continue; // we only want flex-rigid interaction
-		const atom& a = atoms[i];
-		smt t1 = a.get();
-		if (t1 >= nat)
+		const atom& a = atoms[flex_rigid_atoms[k]];
+		if (hydrogens_stale && a.is_hydrogen())
 			continue;
-		VINA_FOR_IN(j, grid_atoms)
-		{
-			const atom& b = grid_atoms[j];
-			smt t2 = b.get();
-			if (t2 >= nat)
-				continue;
-			fl r2 = vec_distance_sqr(coords[i], b.coords);
-			if (r2 < cutoff_sqr)
-			{
-				fl this_e = p.eval(a, b, r2);
-				curl(this_e, v[1]);
-				e += this_e;
-			}
-		}
+		rigid_index->for_each_near(coords[flex_rigid_atoms[k]],
+				[&](sz j, fl r2) {
+					fl this_e = p.eval(a, grid_atoms[j], r2);
+					curl(this_e, v[1]);
+					e += this_e;
+				});
 	}
 
 
 // flex-flex
-	VINA_FOR_IN(i, other_pairs)
+	VINA_FOR_IN(i, flex_flex_pairs)
 	{
-		const interacting_pair& pair = other_pairs[i];
-		if (find_ligand(pair.a) < ligands.size()
-				|| find_ligand(pair.b) < ligands.size())
-			continue; // we only need flex-flex
+		const interacting_pair& pair = flex_flex_pairs[i];
+		if (hydrogens_stale && (atoms[pair.a].is_hydrogen() || atoms[pair.b].is_hydrogen()))
+			continue;
 		fl r2 = vec_distance_sqr(coords[pair.a], coords[pair.b]);
 		if (r2 < cutoff_sqr)
 		{
@@ -1090,29 +1208,76 @@ fl model::eval_adjusted(const scoring_function& sf, const precalculate& p,
 	return sf.conf_independent(*this, e - intramolecular_energy);
 }
 
+//heavy movable atoms of a model grouped by element, with coordinates stored
+//as separate x/y/z arrays so the nearest-neighbor scan is a flat loop
+struct element_buckets
+{
+	std::vector<sz> elements;
+	std::vector<flv> x, y, z;
+
+	element_buckets(const atomv& atoms, const vecv& coords, sz n)
+	{
+		VINA_FOR(i, n)
+		{
+			const atom& a = atoms[i];
+			if (a.is_hydrogen())
+				continue;
+			sz b = find(smina_atom_type::data[a.sm].el);
+			x[b].push_back(coords[i][0]);
+			y[b].push_back(coords[i][1]);
+			z[b].push_back(coords[i][2]);
+		}
+	}
+
+	//index of el's bucket, added if missing
+	sz find(sz el)
+	{
+		VINA_FOR_IN(b, elements)
+			if (elements[b] == el)
+				return b;
+		elements.push_back(el);
+		x.resize(elements.size());
+		y.resize(elements.size());
+		z.resize(elements.size());
+		return elements.size() - 1;
+	}
+
+	//squared distance from p to the closest atom of bucket b
+	fl min_distance_sqr(sz b, const vec& p) const
+	{
+		const flv& bx = x[b];
+		const flv& by = y[b];
+		const flv& bz = z[b];
+		fl r2 = max_fl;
+		VINA_FOR_IN(j, bx)
+		{
+			fl d = sqr(bx[j] - p[0]) + sqr(by[j] - p[1]) + sqr(bz[j] - p[2]);
+			r2 = (d < r2) ? d : r2;
+		}
+		return r2;
+	}
+};
+
 fl model::rmsd_lower_bound_asymmetric(const model& x, const model& y) const
 		{ // actually static
 	sz n = x.m_num_movable_atoms;
 	VINA_CHECK(n == y.m_num_movable_atoms);
+	element_buckets ybuckets(y.atoms, y.coords, n);
 	fl sum = 0;
 	unsigned counter = 0;
+	sz last_el = max_sz, b = 0;
 	VINA_FOR(i, n)
 	{
 		const atom& a = x.atoms[i];
 		if (!a.is_hydrogen())
 		{
-			fl r2 = max_fl;
-			VINA_FOR(j, n)
+			sz el = smina_atom_type::data[a.sm].el;
+			if (el != last_el) //consecutive atoms are often the same element
 			{
-				const atom& b = y.atoms[j];
-				if (a.same_element(b) && !b.is_hydrogen())
-				{
-					fl this_r2 = vec_distance_sqr(x.coords[i],
-							y.coords[j]);
-					if (this_r2 < r2)
-						r2 = this_r2;
-				}
+				b = ybuckets.find(el);
+				last_el = el;
 			}
+			fl r2 = ybuckets.min_distance_sqr(b, x.coords[i]);
 			assert(not_max(r2));
 			sum += r2;
 			++counter;
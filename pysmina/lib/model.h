@@ -25,6 +25,7 @@
 
 #include <boost/optional.hpp> // for context
 #include <boost/serialization/utility.hpp>
+#include <boost/shared_ptr.hpp>
 #include <string>
 #include "optional_serialization.h"
 #include "file.h"
@@ -34,6 +35,9 @@
 #include "igrid.h"
 #include "grid_dim.h"
 #include "grid.h"
+#include "rigid_cells.h"
+#include "flat_tree.h"
+#include "type_groups.h"
 
 struct interacting_pair {
 	smt t1;
@@ -82,7 +86,12 @@ struct sdfcontext {
 		void serialize(Archive& ar, const unsigned version) {
 			ar & elem;
 			//do NOT export index since this is not set until model creation
-			//same for inflex
+			//same for inflex, unless it's a created model that's saved
+			if(exact_archive<Archive>::value)
+			{
+				ar & index;
+				ar & inflex;
+			}
 		}
 	};
 	struct sdfbond { //bond connectivity and type
@@ -180,6 +189,12 @@ struct ligand : public flexible_body, atom_range {
 struct residue : public main_branch {
 	residue() {} //serialization
 	residue(const main_branch& m) : main_branch(m) {}
+
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned version) {
+		ar & boost::serialization::base_object<main_branch>(*this);
+	}
 };
 
 enum distance_type {DISTANCE_FIXED, DISTANCE_ROTOR, DISTANCE_VARIABLE};
@@ -206,6 +221,8 @@ struct model {
 	sz ligand_longest_branch(sz ligand_number) const;
 	sz ligand_length(sz ligand_number) const;
 	void get_movable_atom_types(std::vector<smt>& movingtypes) const;
+	void get_flex_atom_types(std::vector<smt>& flextypes) const; // movable atoms outside the ligands
+	void get_atom_types(std::vector<smt>& types) const; // every atom, including the grid atoms
 
 	void set_name(const std::string& n) { name = n; }
 	const std::string& get_name() const { return name; }
@@ -260,6 +277,12 @@ struct model {
 	void sete(const conf& c);
 	void set (const conf& c);
 
+	//search mode in which set moves only the heavy atoms of ligands and flex;
+	//nothing scores hydrogens, and set_hydrogens places them when needed
+	void set_heavy_atoms_only(bool b) { heavy_atoms_only = b; }
+	bool hydrogens_current() const { return !hydrogens_stale; }
+	void set_hydrogens(); // from the frames of the last set
+
 	std::string ligand_atom_str(sz i, sz lig=0) const;
 	fl gyration_radius(sz ligand_number) const; // uses coords
 
@@ -329,7 +352,7 @@ struct model {
 
 	fl clash_penalty() const;
 
-	model() : m_num_movable_atoms(0) {};
+	model() : m_num_movable_atoms(0), num_movable_flex_rigid(0), flex_rigid_built_for(max_sz), heavy_atoms_only(false), hydrogens_stale(false) {};
 
 private:
 	//my, aren't we friendly!
@@ -339,6 +362,7 @@ private:
 	friend struct cache;
 	friend struct szv_grid;
 	friend class szv_grid_cache;
+	friend class lazy_cache;
 	friend struct terms;
 	friend struct conf_independent_inputs;
 	friend struct appender_info;
@@ -374,6 +398,12 @@ private:
 	void initialize_pairs(const distance_type_matrix& mobility);
 	void initialize(const distance_type_matrix& mobility);
 	fl clash_penalty_aux(const interacting_pairs& pairs) const;
+	void update_flex_rigid(fl cutoff_sqr);
+	void update_pair_plans(const precalculate& p);
+	void update_kinematics();
+	const pair_plan* ligand_plan(sz i) const { return i < ligand_plans.size() ? &ligand_plans[i] : NULL; }
+	fl eval_pairs(const precalculate& p, fl v, const interacting_pairs& pairs, const pair_plan* plan, const vecv& coords) const;
+	fl eval_pairs_deriv(const precalculate& p, fl v, const interacting_pairs& pairs, const pair_plan* plan, const vecv& coords, vecv& forces) const;
 
 	fl eval_interacting_pairs(const precalculate& p, fl v, const interacting_pairs& pairs, const vecv& coords) const;
 	fl eval_interacting_pairs_deriv(const precalculate& p, fl v, const interacting_pairs& pairs, const vecv& coords, vecv& forces) const;
@@ -392,7 +422,54 @@ private:
 
 	sz m_num_movable_atoms;
 
+	//flex-rigid bookkeeping, (re)built on demand by update_flex_rigid
+	boost::shared_ptr<const rigid_cells> rigid_index; //shared between copies
+	szv flex_rigid_atoms; //non-ligand atoms of a known type, movable first
+	sz num_movable_flex_rigid; //leading entries of flex_rigid_atoms that are movable
+	interacting_pairs flex_flex_pairs; //other_pairs not involving a ligand
+	sz flex_rigid_built_for; //atoms.size() when the lists were built
+
+	//ligands[i].pairs and other_pairs compiled by update_pair_plans
+	std::vector<pair_plan> ligand_plans;
+	pair_plan other_plan;
+
+	flat_tree kinematics; //ligands and flex, (re)built by update_kinematics
+	type_groups grid_groups; //movable atoms by type for grid lookups, (re)built by set
+	bool heavy_atoms_only;
+	bool hydrogens_stale; //set left the hydrogens where they were
+
 	std::string name;
+
+	//everything but what is rebuilt on demand
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned version) {
+		ar & internal_coords;
+		ar & coords;
+		ar & minus_forces;
+		ar & grid_atoms;
+		ar & atoms;
+		ar & static_cast<std::vector<ligand>&>(ligands);
+		ar & static_cast<std::vector<residue>&>(flex);
+		ar & flex_context;
+		ar & other_pairs;
+		ar & m_num_movable_atoms;
+		ar & name;
+		if(Archive::is_loading::value)
+		{
+			rigid_index.reset();
+			flex_rigid_atoms.clear();
+			num_movable_flex_rigid = 0;
+			flex_flex_pairs.clear();
+			flex_rigid_built_for = max_sz;
+			ligand_plans.clear();
+			other_plan = pair_plan();
+			kinematics.clear();
+			grid_groups = type_groups();
+			heavy_atoms_only = false;
+			hydrogens_stale = false;
+		}
+	}
 };
 
 #endif
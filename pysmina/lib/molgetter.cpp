@@ -12,6 +12,26 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include "SminaConverter.h"
 
+//add a ligand read from smina format to m
+static void appendSmina(model &m, parsing_struct& p, context& c, unsigned torsdof)
+{
+	non_rigid_parsed nr;
+	postprocess_ligand(nr, p, c, torsdof);
+	VINA_CHECK(nr.atoms_atoms_bonds.dim() == nr.atoms.size());
+
+	pdbqt_initializer tmp;
+	tmp.initialize_from_nrp(nr, c, true);
+	tmp.initialize(nr.mobility_matrix());
+
+	if(c.sdftext.valid())
+	{
+		//set name
+		m.set_name(c.sdftext.name);
+	}
+
+	m.append(tmp.m);
+}
+
 //setup for reading from fname
 void MolGetter::setInputFile(const std::string& fname)
 {
@@ -24,6 +44,15 @@ void MolGetter::setInputFile(const std::string& fname)
 			type = PDBQT;
 			pdbqtdone = false;
 		}
+		else if (smina_library::is_library(lpath))
+		{
+			//indexed library, only read our shard
+			type = SMINALIB;
+			library.reset(new smina_library(lpath));
+			std::pair<sz, sz> range = library->shard(shard, num_shards);
+			libnext = range.first;
+			libend = range.second;
+		}
 		else if (infile.open(lpath, ".smina", true)) //smina always gzipped
 		{
 			type = SMINA;
@@ -62,21 +91,7 @@ bool MolGetter::readMoleculeIntoModel(model &m)
 			serialin >> p;
 			serialin >> c;
 
-			non_rigid_parsed nr;
-			postprocess_ligand(nr, p, c, torsdof);
-			VINA_CHECK(nr.atoms_atoms_bonds.dim() == nr.atoms.size());
-
-			pdbqt_initializer tmp;
-			tmp.initialize_from_nrp(nr, c, true);
-			tmp.initialize(nr.mobility_matrix());
-
-			if(c.sdftext.valid())
-			{
-				//set name
-				m.set_name(c.sdftext.name);
-			}
-
-			m.append(tmp.m);
+			appendSmina(m, p, c, torsdof);
 			return true;
 		}
 		catch (boost::archive::archive_exception& e)
@@ -85,6 +100,18 @@ bool MolGetter::readMoleculeIntoModel(model &m)
 		}
 	}
 		break;
+	case SMINALIB:
+		{
+		if (libnext >= libend)
+			return false;
+		parsing_struct p;
+		context c;
+		unsigned torsdof = library->read(libnext, p, c);
+		libcurrent = libnext++;
+		appendSmina(m, p, c, torsdof);
+		return true;
+	}
+		break;
 	case PDBQT:
 		{
 		if (pdbqtdone)
@@ -10,17 +10,19 @@
 
 #include "model.h"
 #include "obmolopener.h"
+#include "smina_library.h"
+#include <memory>
 
 
 //this class abstracts reading molecules from a file
-//we have three means of input:
+//we have four means of input:
 //openbabel for general molecular data (default)
 //vina parse_pdbqt for pdbqt files (one ligand, obey rotational bonds)
-//smina format
+//smina format, read in order or, for an indexed library, by shard
 class MolGetter
 {
 	const model& initm;
-	enum Type {OB, PDBQT, SMINA}; //different inputs
+	enum Type {OB, PDBQT, SMINA, SMINALIB}; //different inputs
 
 	Type type;
 	path lpath;
@@ -31,11 +33,16 @@ class MolGetter
 
 	//smina data structs
 	izfile infile;
+	std::unique_ptr<smina_library> library;
+	sz shard, num_shards;
+	sz libnext, libend, libcurrent; //positions in library
 
 	//pdbqt data
 	bool pdbqtdone;
 public:
-	MolGetter(const model& m, bool addH): initm(m), add_hydrogens(addH), pdbqtdone(false) {}
+	//shard of num_shards is read from indexed libraries
+	MolGetter(const model& m, bool addH, sz shard_ = 0, sz num_shards_ = 1): initm(m), add_hydrogens(addH),
+			shard(shard_), num_shards(num_shards_), libnext(0), libend(0), libcurrent(0), pdbqtdone(false) {}
 
 	//setup for reading from fname
 	void setInputFile(const std::string& fname);
@@ -43,6 +50,13 @@ public:
 	//initialize model to initm and add next molecule
 	//return false if no molecule available;
 	bool readMoleculeIntoModel(model &m);
+
+	//for an indexed library, the position in the file of the last molecule
+	//read and the number of molecules in the file, so molecules can be
+	//numbered the same however the library is sharded
+	bool indexed() const { return type == SMINALIB; }
+	sz libraryIndex() const { return libcurrent; }
+	sz librarySize() const { return library->size(); }
 };
 
 
@@ -82,8 +82,8 @@ output_type monte_carlo::many_runs(model& m, const precalculate& p, const igrid&
 }
 
 
-// out is sorted
-void monte_carlo::operator()(model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, incrementable* increment_me, rng& generator, grid& user_grid) const {
+// out is sorted; returns the number of steps actually taken
+unsigned monte_carlo::operator()(model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, incrementable* increment_me, rng& generator, grid& user_grid, mc_board* board, sz slot) const {
 	vec authentic_v(1000, 1000, 1000); // FIXME? this is here to avoid max_fl/max_fl
 	conf_size s = m.get_size();
 	change g(s);
@@ -94,7 +94,43 @@ void monte_carlo::operator()(model& m, output_container& out, const precalculate
 	if(minparms.maxiters == 0)
 		minparms.maxiters = ssd_par.evals;
 	quasi_newton quasi_newton_par(minparms);
-	VINA_U_FOR(step, num_steps) {
+	unsigned seen_generation = 0;
+	unsigned last_progress = 0;
+
+	// adaptive mode: look at the chain every window steps; cut it once it has
+	// stalled, extend it from the shared pool while it is still improving
+	const bool adaptive = adaptive_steps && board;
+	const unsigned window = (std::max)(num_steps / 20, 50u);
+	unsigned limit = num_steps;
+	unsigned window_accepted = 0;
+	unsigned stalled_windows = 0;
+	fl window_start_e = max_fl;
+
+	unsigned step = 0;
+	for(; step < limit; ++step) {
+		if(board && !out.empty()) {
+			unsigned gen = board->get_generation();
+			if(gen != seen_generation) {
+				seen_generation = gen;
+				last_progress = step;
+			}
+			if(board->converged() || (early_term_patience > 0 && step - last_progress > early_term_patience))
+				break;
+			if(board->expired()) // anytime: keep what we have, the caller refines it
+				break;
+		}
+		if(adaptive && step > 0 && step % window == 0) {
+			fl acceptance = fl(window_accepted) / window;
+			if(best_e < window_start_e - adaptive_min_improvement)
+				stalled_windows = 0;
+			else
+				++stalled_windows;
+			window_start_e = best_e;
+			window_accepted = 0;
+			// a frozen chain (almost nothing accepted) is given up on sooner
+			if(step >= num_steps / 4 && (stalled_windows >= 2 || (stalled_windows >= 1 && acceptance < 0.05)))
+				break;
+		}
 		if(increment_me)
 			++(*increment_me);
 		output_type candidate = tmp;
@@ -102,6 +138,7 @@ void monte_carlo::operator()(model& m, output_container& out, const precalculate
 		quasi_newton_par(m, p, ig, candidate, g, hunt_cap, user_grid);
 		if(step == 0 || metropolis_accept(tmp.e, candidate.e, temperature, generator)) {
 			tmp = candidate;
+			++window_accepted;
 
 			m.set(tmp.c); // FIXME? useless?
 
@@ -111,11 +148,18 @@ void monte_carlo::operator()(model& m, output_container& out, const precalculate
 				m.set(tmp.c); // FIXME? useless?
 				tmp.coords = m.get_heavy_atom_movable_coords();
 				add_to_output_container(out, tmp, min_rmsd, num_saved_mins); // 20 - max size
+				if(board)
+					board->publish(slot, tmp.e, tmp.coords);
 				if(tmp.e < best_e)
 					best_e = tmp.e;
 			}
 		}
+		if(adaptive && step + 1 == limit && stalled_windows == 0 && board->take_steps(window))
+			limit += window;
 	}
+	if(board && step < limit)
+		board->return_steps(limit - step); // unused share goes to the chains still improving
 	VINA_CHECK(!out.empty());
 	VINA_CHECK(out.front().e <= out.back().e); // make sure the sorting worked in the correct order
+	return step;
 }
@@ -25,6 +25,7 @@
 
 #include "ssd.h"
 #include "incrementable.h"
+#include "mc_board.h"
 
 struct monte_carlo {
 	unsigned num_steps;
@@ -34,14 +35,22 @@ struct monte_carlo {
 	sz num_saved_mins;
 	fl mutation_amplitude;
 	ssd ssd_par;
-	monte_carlo() : num_steps(2500), temperature(1.2), hunt_cap(10, 1.5, 10), min_rmsd(0.5), num_saved_mins(50), mutation_amplitude(2) {} // T = 600K, R = 2cal/(K*mol) -> temperature = RT = 1.2;  num_steps = 50*lig_atoms = 2500
+	sz early_term_hits; // stop once the best pose was rediscovered by this many other tasks (0 = off)
+	unsigned early_term_patience; // stop after this many steps without the shared best improving (0 = off)
+	bool adaptive_steps; // cut stalled chains and extend improving ones, num_steps becomes the per-chain share of the budget
+	fl step_budget; // adaptive mode: total steps allowed per ligand, as a multiple of num_tasks * num_steps
+	fl adaptive_min_improvement; // adaptive mode: smallest drop in best energy over a window that counts as progress
+	monte_carlo() : num_steps(2500), temperature(1.2), hunt_cap(10, 1.5, 10), min_rmsd(0.5), num_saved_mins(50), mutation_amplitude(2), early_term_hits(0), early_term_patience(0), adaptive_steps(false), step_budget(1), adaptive_min_improvement(0.01) {} // T = 600K, R = 2cal/(K*mol) -> temperature = RT = 1.2;  num_steps = 50*lig_atoms = 2500
+	bool needs_board() const { return early_term_hits > 0 || early_term_patience > 0 || adaptive_steps; }
 
 	output_type operator()(model& m, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, incrementable* increment_me, rng& generator, grid& user_grid) const;
 	output_type many_runs(model& m, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, sz num_runs, rng& generator, grid& user_grid) const;
 
 	void single_run(model& m, output_type& out, const precalculate& p, const igrid& ig, rng& generator, grid& user_grid) const;
 	// out is sorted
-	void operator()(model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, incrementable* increment_me, rng& generator, grid& user_grid) const;
+	// board, if given, is shared with the other tasks and used for early termination and adaptive steps; slot is this task's entry
+	// returns the number of steps taken
+	unsigned operator()(model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, incrementable* increment_me, rng& generator, grid& user_grid, mc_board* board = NULL, sz slot = 0) const;
 	void many_runs(model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, sz num_runs, rng& generator, grid& user_grid) const;
 
 };
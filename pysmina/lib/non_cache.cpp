@@ -21,15 +21,24 @@
  */
 
 #include "non_cache.h"
+#include "cache.h"
 #include "curl.h"
 
 non_cache::non_cache(szv_grid_cache& gcache, const grid_dims& gd_,
 		const precalculate* p_, fl slope_) :
 		sgrid(gcache, gd_), gd(gd_), p(p_), slope(
-				slope_)
+				slope_), flex_grids(NULL)
 {
 }
 
+//precomputed grid for movable atom i if it belongs to a flex residue
+const grid* non_cache::flex_grid(const model& m, sz i) const
+{
+	if (flex_grids == NULL || m.find_ligand(i) < m.ligands.size())
+		return NULL;
+	return flex_grids->type_grid(m.atoms[i].get());
+}
+
 fl non_cache::eval(const model& m, fl v) const
 { // clean up
 	fl e = 0;
@@ -67,21 +76,29 @@ fl non_cache::eval(const model& m, fl v) const
 		}
 		out_of_bounds_penalty *= slope;
 
-		const szv& possibilities = sgrid.possibilities(adjusted_a_coords);
-
-		VINA_FOR_IN(possibilities_j, possibilities)
+		if (const grid* g = flex_grid(m, i))
 		{
-			const sz j = possibilities[possibilities_j];
-			const atom& b = m.grid_atoms[j];
-			smt t2 = b.get();
-			vec r_ba;
-			r_ba = adjusted_a_coords - b.coords; // FIXME why b-a and not a-b ?
-			fl r2 = sqr(r_ba);
-			if (r2 < cutoff_sqr)
+			//uncurled value at the clamped position, treated like the pairwise sum
+			this_e = g->evaluate(a, adjusted_a_coords, 0, max_fl);
+		}
+		else
+		{
+			const szv& possibilities = sgrid.possibilities(adjusted_a_coords);
+
+			VINA_FOR_IN(possibilities_j, possibilities)
 			{
-				//jac241 - Use adjusted_a_coords or just a_coords?
-				//also how to verify they're ligand coordinates (table lookup?)
-				this_e += p->eval(a, b, r2); // + user_grid.evaluate_user(adjusted_a_coords, slope, NULL);
+				const sz j = possibilities[possibilities_j];
+				const atom& b = m.grid_atoms[j];
+				smt t2 = b.get();
+				vec r_ba;
+				r_ba = adjusted_a_coords - b.coords; // FIXME why b-a and not a-b ?
+				fl r2 = sqr(r_ba);
+				if (r2 < cutoff_sqr)
+				{
+					//jac241 - Use adjusted_a_coords or just a_coords?
+					//also how to verify they're ligand coordinates (table lookup?)
+					this_e += p->eval(a, b, r2); // + user_grid.evaluate_user(adjusted_a_coords, slope, NULL);
+				}
 			}
 		}
 		curl(this_e, v);
@@ -106,7 +123,100 @@ bool non_cache::within(const model& m, fl margin) const
 	return true;
 }
 
+bool verlet_lists::stale(const vecv& coords, sz n) const
+{
+	if (built_at.size() != n)
+		return true;
+	const fl limit = sqr(skin / 2);
+	VINA_FOR(i, n)
+		if (vec_distance_sqr(coords[i], built_at[i]) > limit)
+			return true;
+	return false;
+}
+
+fl non_cache::clamp_to_grid(const vec& a_coords, vec& adjusted, vec& deriv) const
+{
+	fl penalty = 0;
+	adjusted = a_coords;
+	deriv = vec(0, 0, 0);
+	VINA_FOR_IN(j, gd)
+	{
+		if (gd[j].n > 0)
+		{
+			if (a_coords[j] < gd[j].begin)
+			{
+				adjusted[j] = gd[j].begin;
+				deriv[j] = -1;
+				penalty += std::abs(a_coords[j] - gd[j].begin);
+			}
+			else if (a_coords[j] > gd[j].end)
+			{
+				adjusted[j] = gd[j].end;
+				deriv[j] = 1;
+				penalty += std::abs(a_coords[j] - gd[j].end);
+			}
+		}
+	}
+	return penalty;
+}
+
+//an atom that stays within skin/2 of its clamped position p only ever sees
+//receptor atoms within cutoff of some grid cell overlapping p +/- skin, so
+//those cells' possibilities, filtered by distance, make a complete list
+void non_cache::build_verlet_lists(const model& m, verlet_lists& nl) const
+{
+	const fl range_sqr = sqr(std::sqrt(p->cutoff_sqr()) + nl.skin);
+	sz n = num_atom_types();
+	sz num_movable = m.num_movable_atoms();
+
+	nl.built_at.assign(m.coords.begin(), m.coords.begin() + num_movable);
+	nl.atoms.resize(num_movable);
+	VINA_FOR(i, num_movable)
+	{
+		szv& list = nl.atoms[i];
+		list.clear();
+		smt t1 = m.atoms[i].get();
+		if (t1 >= n || is_hydrogen(t1))
+			continue;
+
+		vec adjusted, unused;
+		clamp_to_grid(m.coords[i], adjusted, unused);
+		vec lo = adjusted, hi = adjusted;
+		VINA_FOR_IN(j, gd)
+		{
+			if (gd[j].n > 0)
+			{
+				lo[j] = (std::max)(adjusted[j] - nl.skin, gd[j].begin);
+				hi[j] = (std::min)(adjusted[j] + nl.skin, gd[j].end);
+			}
+		}
+		sgrid.possibilities(lo, hi, list);
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+
+		sz kept = 0;
+		VINA_FOR_IN(k, list)
+		{
+			if (vec_distance_sqr(adjusted, m.grid_atoms[list[k]].coords) < range_sqr)
+				list[kept++] = list[k];
+		}
+		list.resize(kept);
+	}
+}
+
 fl non_cache::eval_deriv(model& m, fl v, const grid& user_grid) const
+{
+	return eval_deriv(m, v, user_grid, NULL);
+}
+
+fl non_cache::eval_deriv(model& m, fl v, const grid& user_grid, verlet_lists& nl) const
+{
+	if (nl.stale(m.coords, m.num_movable_atoms()))
+		build_verlet_lists(m, nl);
+	return eval_deriv(m, v, user_grid, &nl);
+}
+
+fl non_cache::eval_deriv(model& m, fl v, const grid& user_grid, verlet_lists* nl) const
 		{ // clean up
 	fl e = 0;
 	const fl cutoff_sqr = p->cutoff_sqr();
@@ -132,49 +242,38 @@ fl non_cache::eval_deriv(model& m, fl v, const grid& user_grid) const
 		}
 		const vec& a_coords = m.coords[i];
 		vec adjusted_a_coords;
-		adjusted_a_coords = a_coords;
-		VINA_FOR_IN(j, gd)
-		{
-			if (gd[j].n > 0)
-			{
-				if (a_coords[j] < gd[j].begin)
-				{
-					adjusted_a_coords[j] = gd[j].begin;
-					out_of_bounds_deriv[j] = -1;
-					out_of_bounds_penalty += std::abs(
-							a_coords[j] - gd[j].begin);
-				}
-				else if (a_coords[j] > gd[j].end)
-				{
-					adjusted_a_coords[j] = gd[j].end;
-					out_of_bounds_deriv[j] = 1;
-					out_of_bounds_penalty += std::abs(a_coords[j] - gd[j].end);
-				}
-			}
-		}
+		out_of_bounds_penalty = clamp_to_grid(a_coords, adjusted_a_coords, out_of_bounds_deriv);
 		out_of_bounds_penalty *= slope;
 		out_of_bounds_deriv *= slope;
 
-		const szv& possibilities = sgrid.possibilities(adjusted_a_coords);
-		VINA_FOR_IN(possibilities_j, possibilities)
+		if (const grid* g = flex_grid(m, i))
+		{
+			//uncurled value at the clamped position, treated like the pairwise sum
+			this_e = g->evaluate(a, adjusted_a_coords, 0, max_fl, &deriv);
+		}
+		else
 		{
-			const sz j = possibilities[possibilities_j];
-			const atom& b = m.grid_atoms[j];
-			smt t2 = b.get();
-			vec r_ba;
-			r_ba = adjusted_a_coords - b.coords;
-			fl r2 = sqr(r_ba);
-
-			if (r2 < cutoff_sqr)
+			const szv& possibilities = nl ? nl->atoms[i] : sgrid.possibilities(adjusted_a_coords);
+			VINA_FOR_IN(possibilities_j, possibilities)
 			{
-			  if(r2 < epsilon_fl) {
-			    throw std::runtime_error("Ligand atom exactly overlaps receptor atom.  I can't deal with this.");
-			  }
-				//dkoes - the "derivative" value returned by eval_deriv
-				//is normalized by r (dor = derivative over r?)
-				pr e_dor = p->eval_deriv(a, b, r2);
-				this_e += e_dor.first;
-				deriv += e_dor.second * r_ba;
+				const sz j = possibilities[possibilities_j];
+				const atom& b = m.grid_atoms[j];
+				smt t2 = b.get();
+				vec r_ba;
+				r_ba = adjusted_a_coords - b.coords;
+				fl r2 = sqr(r_ba);
+
+				if (r2 < cutoff_sqr)
+				{
+				  if(r2 < epsilon_fl) {
+				    throw std::runtime_error("Ligand atom exactly overlaps receptor atom.  I can't deal with this.");
+				  }
+					//dkoes - the "derivative" value returned by eval_deriv
+					//is normalized by r (dor = derivative over r?)
+					pr e_dor = p->eval_deriv(a, b, r2);
+					this_e += e_dor.first;
+					deriv += e_dor.second * r_ba;
+				}
 			}
 		}
 		if(user_grid.initialized())
@@ -26,20 +26,62 @@
 #include "igrid.h"
 #include "szv_grid.h"
 
+//Verlet neighbor lists for one minimization: for every movable atom, the
+//receptor atoms within cutoff + skin of where the atom was when the lists
+//were built.  They stay valid until some atom moves more than skin/2.
+struct verlet_lists {
+	fl skin;
+	vecv built_at; //movable atom coordinates at the last rebuild
+	std::vector<szv> atoms;
+
+	verlet_lists(fl skin_ = 1.0) : skin(skin_) {}
+	//true if any of the first n coords moved more than skin/2 since the build
+	bool stale(const vecv& coords, sz n) const;
+};
+
+struct cache; // forward declaration
+
 struct non_cache : public igrid {
 	non_cache(szv_grid_cache& gcache, const grid_dims& gd_,
 			const precalculate* p_, fl slope_=1e6);
 	virtual ~non_cache() {}
 	virtual fl eval      (const model& m, fl v) const; // needs m.coords // clean up
 	virtual fl eval_deriv(      model& m, fl v, const grid& user_grid) const; // needs m.coords, sets m.minus_forces // clean up
+	//same, but takes receptor atoms from nl (rebuilt first if stale) instead of sgrid
+	fl eval_deriv(model& m, fl v, const grid& user_grid, verlet_lists& nl) const;
+	void build_verlet_lists(const model& m, verlet_lists& nl) const;
 	bool within(const model& m, fl margin = 0.0001) const;
 	void setSlope(fl sl) { slope = sl; }
 	fl getSlope() { return slope; }
+	//score flex residue atoms by lookup in these grids (not owned) instead
+	//of pairwise against the receptor; NULL turns it off
+	void set_flex_grids(const cache* c) { flex_grids = c; }
 protected:
-	fl slope;
 	szv_grid sgrid;
 	grid_dims gd;
 	const precalculate* p;
+	fl slope;
+	const cache* flex_grids;
+
+	fl eval_deriv(model& m, fl v, const grid& user_grid, verlet_lists* nl) const;
+	//clamp a_coords to the grid, return the (unscaled) out of bounds penalty
+	fl clamp_to_grid(const vec& a_coords, vec& adjusted, vec& deriv) const;
+	const grid* flex_grid(const model& m, sz i) const;
+};
+
+//igrid view of a non_cache that carries its own Verlet lists, so one
+//local minimization doesn't look up grid cells on every evaluation;
+//holds mutable state and must not be shared between threads
+struct non_cache_verlet : public igrid {
+	non_cache_verlet(const non_cache& nc_, fl skin = 1.0) : nc(nc_), nl(skin) {}
+	virtual fl eval(const model& m, fl v) const { return nc.eval(m, v); }
+	virtual fl eval_deriv(model& m, fl v, const grid& user_grid) const
+	{
+		return nc.eval_deriv(m, v, user_grid, nl);
+	}
+private:
+	const non_cache& nc;
+	mutable verlet_lists nl;
 };
 
 #endif
@@ -0,0 +1,73 @@
+/*
+ * pair_plan.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_PAIR_PLAN_H
+#define SMINA_PAIR_PLAN_H
+
+#include <cmath>
+#include <cstdint>
+#include "common.h"
+
+// A list of interacting pairs compiled against one precalculate: atom
+// indices narrowed to 16 bits, the table entry of each pair resolved and
+// ordered to match it, and the charge factors of the scoring terms
+// multiplied out, so evaluating a pair needs no atom, type or charge lookups.
+// Only built by approximations that support it (see precalculate::add_to_plan);
+// otherwise the model keeps evaluating its interacting_pairs directly.
+struct pair_plan
+{
+	static const sz max_index = 0xffff;
+
+	std::vector<uint16_t> a;
+	std::vector<uint16_t> b;
+	std::vector<const fl*> rows; //precalculate_linear table of the pair
+	flv abs_a; //|charge of a|
+	flv abs_b; //|charge of b|
+	flv ab; //charge of a * charge of b
+
+	sz serial; //precalculate::serial() the plan was compiled for, 0 if none
+	sz built_for; //number of model atoms when compiled
+	bool usable; //false if the precalculate could not compile the pairs
+
+	pair_plan() :
+			serial(0), built_for(max_sz), usable(false)
+	{
+	}
+
+	sz size() const
+	{
+		return rows.size();
+	}
+
+	bool compiled_for(sz serial_, sz num_atoms) const
+	{
+		return serial == serial_ && built_for == num_atoms;
+	}
+
+	void clear()
+	{
+		a.clear();
+		b.clear();
+		rows.clear();
+		abs_a.clear();
+		abs_b.clear();
+		ab.clear();
+		usable = false;
+	}
+
+	void add(sz i, sz j, const fl* row, fl qa, fl qb)
+	{
+		assert(i <= max_index && j <= max_index);
+		a.push_back(uint16_t(i));
+		b.push_back(uint16_t(j));
+		rows.push_back(row);
+		abs_a.push_back(std::abs(qa));
+		abs_b.push_back(std::abs(qb));
+		ab.push_back(qa * qb);
+	}
+};
+
+#endif /* SMINA_PAIR_PLAN_H */
@@ -20,6 +20,8 @@
 
  */
 
+#include <boost/scoped_ptr.hpp>
+
 #include "parallel.h"
 #include "parallel_mc.h"
 #include "coords.h"
@@ -30,8 +32,10 @@ struct parallel_mc_task
 	model m;
 	output_container out;
 	rng generator;
-	parallel_mc_task(const model& m_, int seed) :
-			m(m_), generator(static_cast<rng::result_type>(seed))
+	sz index;
+	unsigned steps; // actually taken
+	parallel_mc_task(const model& m_, const rng& generator_, sz index_) :
+			m(m_), generator(generator_), index(index_), steps(0)
 	{
 	}
 };
@@ -47,28 +51,34 @@ struct parallel_mc_aux
 	const vec* corner2;
 	parallel_progress* pg;
 	grid* user_grid;
+	mc_board* board;
 	parallel_mc_aux(const monte_carlo* mc_, const precalculate* p_,
 			const igrid* ig_, const vec* corner1_, const vec* corner2_,
-			parallel_progress* pg_, grid* user_grid_)
+			parallel_progress* pg_, grid* user_grid_, mc_board* board_)
 	:
 			mc(mc_), p(p_), ig(ig_), corner1(corner1_), corner2(corner2_), pg(
-					pg_), user_grid(user_grid_)
+					pg_), user_grid(user_grid_), board(board_)
 	{
 	}
 	void operator()(parallel_mc_task& t) const
 	{
-		(*mc)(t.m, t.out, *p, *ig, *corner1, *corner2, pg, t.generator, *user_grid);
+		//tasks not yet started when time runs out are dropped, but the first
+		//one always runs so there is something to return
+		if (board && t.index > 0 && board->expired())
+			return;
+		t.steps = (*mc)(t.m, t.out, *p, *ig, *corner1, *corner2, pg, t.generator, *user_grid, board, t.index);
 	}
 };
 
-void merge_output_containers(const output_container& in, output_container& out,
+//in is left holding moved-from poses
+void merge_output_containers(output_container& in, output_container& out,
 		fl min_rmsd, sz max_size)
 {
 	VINA_FOR_IN(i, in)
-	add_to_output_container(out, in[i], min_rmsd, max_size);
+	add_to_output_container(out, std::move(in[i]), min_rmsd, max_size);
 }
 
-void merge_output_containers(const parallel_mc_task_container& many,
+void merge_output_containers(parallel_mc_task_container& many,
 		output_container& out, fl min_rmsd, sz max_size)
 {
 	min_rmsd = 2; // FIXME? perhaps it's necessary to separate min_rmsd during search and during output?
@@ -77,16 +87,32 @@ void merge_output_containers(const parallel_mc_task_container& many,
 	out.sort();
 }
 
-void parallel_mc::operator()(const model& m, output_container& out,
+parallel_mc_stats parallel_mc::operator()(const model& m, output_container& out,
 		const precalculate& p, const igrid& ig, const vec& corner1,
 		const vec& corner2, rng& generator, grid& user_grid) const
 {
 	parallel_progress pp;
-	parallel_mc_aux parallel_mc_aux_instance(&mc, &p, &ig, &corner1, &corner2,
-			(display_progress ? (&pp) : NULL), &user_grid);
+	//with an adaptive budget each chain starts from its share of the budget,
+	//anything above the nominal steps goes into the board's pool
+	monte_carlo run_mc = mc;
+	long spare = 0;
+	if (mc.adaptive_steps)
+	{
+		if (mc.step_budget < 1)
+			run_mc.num_steps = (std::max)(1u, unsigned(mc.num_steps * mc.step_budget));
+		else
+			spare = long((mc.step_budget - 1) * num_tasks * mc.num_steps);
+	}
+	boost::scoped_ptr<mc_board> board;
+	if (mc.needs_board() || time_limit.is_set())
+		board.reset(new mc_board(num_tasks, mc.min_rmsd, mc.early_term_hits, spare, time_limit));
+	parallel_mc_aux parallel_mc_aux_instance(&run_mc, &p, &ig, &corner1, &corner2,
+			(display_progress ? (&pp) : NULL), &user_grid, board.get());
 	parallel_mc_task_container task_container;
+	// each task gets its own stream split off by task index, so the result
+	// depends only on the caller's stream, not on thread count or scheduling
 	VINA_FOR(i, num_tasks)
-		task_container.push_back(new parallel_mc_task(m, random_int(0, 1000000, generator)));
+		task_container.push_back(new parallel_mc_task(m, generator.split(i), i));
 	// if (display_progress)
 		// pp.init(num_tasks * mc.num_steps);
 	parallel_iter<parallel_mc_aux, parallel_mc_task_container, parallel_mc_task,
@@ -95,4 +121,10 @@ void parallel_mc::operator()(const model& m, output_container& out,
 	parallel_iter_instance.run(task_container);
 	merge_output_containers(task_container, out, mc.min_rmsd,
 			mc.num_saved_mins);
+
+	parallel_mc_stats stats;
+	VINA_FOR_IN(i, task_container)
+		stats.steps += task_container[i].steps;
+	stats.truncated = board && board->was_truncated();
+	return stats;
 }
@@ -24,14 +24,22 @@
 #define VINA_PARALLEL_MC_H
 
 #include "monte_carlo.h"
+#include "deadline.h"
+
+struct parallel_mc_stats {
+	sz steps; // MC steps actually taken over all tasks
+	bool truncated; // stopped by time_limit, results are the best found so far
+	parallel_mc_stats() : steps(0), truncated(false) {}
+};
 
 struct parallel_mc {
 	monte_carlo mc;
 	sz num_tasks;
 	sz num_threads;
 	bool display_progress;
+	deadline time_limit;
 	parallel_mc() : num_tasks(8), num_threads(1), display_progress(true) {}
-	void operator()(const model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, rng& generator, grid& user_grid) const;
+	parallel_mc_stats operator()(const model& m, output_container& out, const precalculate& p, const igrid& ig, const vec& corner1, const vec& corner2, rng& generator, grid& user_grid) const;
 };
 
 #endif
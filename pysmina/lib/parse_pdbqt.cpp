@@ -23,6 +23,9 @@
 #include <fstream> // for getline ?
 #include <sstream> // in parse_two_unsigneds
 #include <cctype> // isspace
+#include <cstring> // memchr
+#include <charconv> // from_chars
+#include <iterator>
 #include <boost/utility.hpp> // for noncopyable 
 #include <boost/optional.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -32,6 +35,8 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/serialization/utility.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/filesystem/operations.hpp>
 #include "parse_pdbqt.h"
 #include "atom_constants.h"
 #include "convert_substring.h"
@@ -56,12 +61,47 @@ struct stream_parse_error: public  parse_error {
 	}
 };
 
-void add_pdbqt_context(context& c, const std::string& str) {
-	c.pdbqttext.push_back(parsed_line(str, boost::optional<sz>()));
+void add_pdbqt_context(context& c, std::string_view str) {
+	c.pdbqttext.push_back(parsed_line(std::string(str), boost::optional<sz>()));
 }
 
+// The text of a pdbqt file in memory, usually a mapped file. Lines are views
+// into it, without the newline, exactly as std::getline would return them, so
+// nothing is copied unless it is kept in a context.
+struct pdbqt_lines {
+	const char* cur;
+	const char* end;
+	pdbqt_lines(const char* begin_, const char* end_) : cur(begin_), end(end_) {}
+};
+
+static bool getline(pdbqt_lines& in, std::string_view& str) {
+	if(in.cur == in.end) return false;
+	const char* nl = static_cast<const char*>(std::memchr(in.cur, '\n', in.end - in.cur));
+	const char* e = nl ? nl : in.end;
+	str = std::string_view(in.cur, e - in.cur);
+	in.cur = nl ? nl + 1 : in.end;
+	return true;
+}
 
-std::string omit_whitespace(const std::string& str, sz i, sz j) {
+// a whole file mapped into memory, for pdbqt_lines
+struct mapped_pdbqt : boost::noncopyable {
+	boost::iostreams::mapped_file_source file;
+	mapped_pdbqt(const path& name) {
+		try {
+			if(boost::filesystem::file_size(name) > 0) // can't map an empty file
+				file.open(name.string());
+		}
+		catch(...) {
+			throw file_error(name, true);
+		}
+	}
+	pdbqt_lines lines() const {
+		if(!file.is_open()) return pdbqt_lines(NULL, NULL);
+		return pdbqt_lines(file.data(), file.data() + file.size());
+	}
+};
+
+std::string omit_whitespace(std::string_view str, sz i, sz j) {
 	if(i < 1) i = 1;
 	if(j < i-1) j = i-1; // i >= 1
 	if(j < str.size()) j = str.size();
@@ -77,7 +117,7 @@ std::string omit_whitespace(const std::string& str, sz i, sz j) {
 	VINA_CHECK(i-1 < str.size());
 	VINA_CHECK(j-i+1 < str.size());
 
-	return str.substr(i-1, j-i+1);
+	return std::string(str.substr(i-1, j-i+1));
 }
 
 struct atom_syntax_error {
@@ -85,8 +125,9 @@ struct atom_syntax_error {
 	atom_syntax_error(const std::string& nature_) : nature(nature_) {}
 };
 
+// the whole field has to be the number, as with lexical_cast
 template<typename T>
-T checked_convert_substring(const std::string& str, sz i, sz j, const std::string& dest_nature) {
+T checked_convert_substring(std::string_view str, sz i, sz j, const std::string& dest_nature) {
 	VINA_CHECK(i >= 1);
 	VINA_CHECK(i <= j+1);
 	if(j > str.size()) throw atom_syntax_error("The line is too short");
@@ -95,16 +136,18 @@ T checked_convert_substring(const std::string& str, sz i, sz j, const std::strin
 	while(i <= j && std::isspace(str[i-1]))
 		++i;
 
-	const std::string substr = str.substr(i-1, j-i+1);
-	try {
-		return boost::lexical_cast<T>(substr);
-	}
-	catch(...) {
-		throw atom_syntax_error(std::string("\"") + substr + "\" is not a valid " + dest_nature);
-	}
+	const char* first = str.data() + i - 1;
+	const char* last = str.data() + j;
+	if(first < last && *first == '+' && std::is_floating_point<T>::value) // from_chars doesn't take a sign
+		++first;
+	T ret = 0;
+	std::from_chars_result res = std::from_chars(first, last, ret);
+	if(res.ec != std::errc() || res.ptr != last || first == last)
+		throw atom_syntax_error(std::string("\"") + std::string(str.substr(i-1, j-i+1)) + "\" is not a valid " + dest_nature);
+	return ret;
 }
 
-parsed_atom parse_pdbqt_atom_string(const std::string& str) {
+parsed_atom parse_pdbqt_atom_string(std::string_view str) {
 	unsigned number = checked_convert_substring<unsigned>(str, 7, 11, "atom number");
 	vec coords(checked_convert_substring<fl>(str, 31, 38, "coordinate"),
 			   checked_convert_substring<fl>(str, 39, 46, "coordinate"),
@@ -118,37 +161,47 @@ parsed_atom parse_pdbqt_atom_string(const std::string& str) {
 	if(tmp.acceptable_type()) 
 		return tmp;
 	else 
-		throw atom_syntax_error(std::string("\"") + name + "\" is not a valid AutoDock type. Note that AutoDock atom types are case-sensitive.\n"+str);
+		throw atom_syntax_error(std::string("\"") + name + "\" is not a valid AutoDock type. Note that AutoDock atom types are case-sensitive.\n"+std::string(str));
 }
 
 
 
 
 
-unsigned parse_one_unsigned(const std::string& str, const std::string& start, unsigned count) {
-	std::istringstream in_str(str.substr(start.size()));
+// the next whitespace separated int, as in_str >> tmp would read it
+static bool parse_next_int(std::string_view& str, int& tmp) {
+	sz i = 0;
+	while(i < str.size() && std::isspace(str[i]))
+		++i;
+	if(i < str.size() && str[i] == '+')
+		++i;
+	std::from_chars_result res = std::from_chars(str.data() + i, str.data() + str.size(), tmp);
+	if(res.ec != std::errc()) return false;
+	str.remove_prefix(res.ptr - str.data());
+	return true;
+}
+
+unsigned parse_one_unsigned(std::string_view str, const std::string& start, unsigned count) {
+	str.remove_prefix(start.size());
 	int tmp;
-	in_str >> tmp;
-	if(!in_str || tmp < 0) 
+	if(!parse_next_int(str, tmp) || tmp < 0) 
 		throw stream_parse_error(count, "Syntax error");
 	return unsigned(tmp);
 }
 
-void parse_two_unsigneds(const std::string& str, const std::string& start, unsigned count, unsigned& first, unsigned& second) {
-	std::istringstream in_str(str.substr(start.size()));
+void parse_two_unsigneds(std::string_view str, const std::string& start, unsigned count, unsigned& first, unsigned& second) {
+	str.remove_prefix(start.size());
 	int tmp1, tmp2;
-	in_str >> tmp1;
-	in_str >> tmp2;
-	if(!in_str || tmp1 < 0 || tmp2 < 0) 
+	if(!parse_next_int(str, tmp1) || !parse_next_int(str, tmp2) || tmp1 < 0 || tmp2 < 0) 
 		throw stream_parse_error(count, "Syntax error");
 	first = unsigned(tmp1);
 	second = unsigned(tmp2);
 }
 
-void parse_pdbqt_rigid(const std::string& name, std::istream& in, rigid& r) {
+void parse_pdbqt_rigid(const std::string& name, pdbqt_lines& in, rigid& r) {
 	unsigned count = 0;
-	std::string str;
-	while(std::getline(in, str)) {
+	std::string_view str;
+	while(getline(in, str)) {
 		++count;
 		if(str.empty()) {} // ignore ""
 		else if(starts_with(str, "TER")) {} // ignore 
@@ -178,9 +231,9 @@ void parse_pdbqt_rigid(const std::string& name, std::istream& in, rigid& r) {
 }
 
 
-void parse_pdbqt_root_aux(std::istream& in, unsigned& count, parsing_struct& p, context& c) {
-	std::string str;
-	while(std::getline(in, str)) {
+void parse_pdbqt_root_aux(pdbqt_lines& in, unsigned& count, parsing_struct& p, context& c) {
+	std::string_view str;
+	while(getline(in, str)) {
 		add_pdbqt_context(c, str);
 		++count;
 		if(str.empty()) {} // ignore ""
@@ -206,9 +259,9 @@ void parse_pdbqt_root_aux(std::istream& in, unsigned& count, parsing_struct& p,
 	}
 }
 
-void parse_pdbqt_root(std::istream& in, unsigned& count, parsing_struct& p, context& c) {
-	std::string str;
-	while(std::getline(in, str)) {
+void parse_pdbqt_root(pdbqt_lines& in, unsigned& count, parsing_struct& p, context& c) {
+	std::string_view str;
+	while(getline(in, str)) {
 		add_pdbqt_context(c, str);
 		++count;
 		if(str.empty()) {} // ignore
@@ -226,9 +279,9 @@ void parse_pdbqt_root(std::istream& in, unsigned& count, parsing_struct& p, cont
 	}
 }
 
-void parse_pdbqt_branch(std::istream& in, unsigned& count, parsing_struct& p, context& c, unsigned from, unsigned to); // forward declaration
+void parse_pdbqt_branch(pdbqt_lines& in, unsigned& count, parsing_struct& p, context& c, unsigned from, unsigned to); // forward declaration
 
-void parse_pdbqt_branch_aux(std::istream& in, unsigned& count, const std::string& str, parsing_struct& p, context& c) {
+void parse_pdbqt_branch_aux(pdbqt_lines& in, unsigned& count, std::string_view str, parsing_struct& p, context& c) {
 	unsigned first, second;
 	parse_two_unsigneds(str, "BRANCH", count, first, second); 
 	sz i = 0;
@@ -252,11 +305,11 @@ void parse_pdbqt_branch_aux(std::istream& in, unsigned& count, const std::string
 		throw stream_parse_error(count, "No atom number " + boost::lexical_cast<std::string>(first) + " in this branch");
 }
 
-void parse_pdbqt_aux(std::istream& in, unsigned& count, parsing_struct& p, context& c, boost::optional<unsigned>& torsdof, bool residue) {
+void parse_pdbqt_aux(pdbqt_lines& in, unsigned& count, parsing_struct& p, context& c, boost::optional<unsigned>& torsdof, bool residue) {
 	parse_pdbqt_root(in, count, p, c);
 
-	std::string str;
-	while(std::getline(in, str)) {
+	std::string_view str;
+	while(getline(in, str)) {
 		add_pdbqt_context(c, str);
 		++count;
 		if(str.empty()) {} // ignore ""
@@ -380,7 +433,7 @@ void postprocess_residue(non_rigid_parsed& nr, parsing_struct& p, context& c) {
 }
 
 //dkoes, stream version
-void parse_pdbqt_ligand_stream(const path& name, std::istream& in, non_rigid_parsed& nr, context& c) {
+void parse_pdbqt_ligand_stream(const path& name, pdbqt_lines& in, non_rigid_parsed& nr, context& c) {
 	unsigned count = 0;
 	parsing_struct p;
 	boost::optional<unsigned> torsdof;
@@ -400,20 +453,21 @@ void parse_pdbqt_ligand_stream(const path& name, std::istream& in, non_rigid_par
 }
 
 void parse_pdbqt_ligand(const path& name, non_rigid_parsed& nr, context& c) {
-	ifile in(name);
+	mapped_pdbqt file(name);
+	pdbqt_lines in = file.lines();
 	parse_pdbqt_ligand_stream(name, in, nr, c);
 }
 
-void parse_pdbqt_residue(std::istream& in, unsigned& count, parsing_struct& p, context& c) { 
+void parse_pdbqt_residue(pdbqt_lines& in, unsigned& count, parsing_struct& p, context& c) { 
 	boost::optional<unsigned> dummy;
 	parse_pdbqt_aux(in, count, p, c, dummy, true);
 }
 
-void parse_pdbqt_flex(const std::string& name, std::istream& in, non_rigid_parsed& nr, context& c) {
+void parse_pdbqt_flex(const std::string& name, pdbqt_lines& in, non_rigid_parsed& nr, context& c) {
 	unsigned count = 0;
-	std::string str;
+	std::string_view str;
 
-	while(std::getline(in, str)) {
+	while(getline(in, str)) {
 		add_pdbqt_context(c, str);
 		++count;
 		if(str.empty()) {} // ignore ""
@@ -437,9 +491,9 @@ void parse_pdbqt_flex(const std::string& name, std::istream& in, non_rigid_parse
 	VINA_CHECK(nr.atoms_atoms_bonds.dim() == nr.atoms.size());
 }
 
-void parse_pdbqt_branch(std::istream& in, unsigned& count, parsing_struct& p, context& c, unsigned from, unsigned to) {
-	std::string str;
-	while(std::getline(in, str)) {
+void parse_pdbqt_branch(pdbqt_lines& in, unsigned& count, parsing_struct& p, context& c, unsigned from, unsigned to) {
+	std::string_view str;
+	while(getline(in, str)) {
 		add_pdbqt_context(c, str);
 		++count;
 		if(str.empty()) {} //ignore ""
@@ -482,31 +536,27 @@ void parse_pdbqt_branch(std::istream& in, unsigned& count, parsing_struct& p, co
 
 
 
-model parse_ligand_stream_pdbqt  (const std::string& name, std::istream& in) { // can throw parse_error
-	non_rigid_parsed nrp;
-	context c;
-	parse_pdbqt_ligand_stream(name, in, nrp, c);
+static pdbqt_lines string_lines(const std::string& text) {
+	return pdbqt_lines(text.data(), text.data() + text.size());
+}
 
-	pdbqt_initializer tmp;
-	tmp.initialize_from_nrp(nrp, c, true);
-	tmp.initialize(nrp.mobility_matrix());
-	return tmp.m;
+static std::string read_stream(std::istream& in) {
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
 }
 
-model parse_ligand_pdbqt  (const path& name) { // can throw parse_error
+static model ligand_from_lines(const std::string& name, pdbqt_lines& in) {
 	non_rigid_parsed nrp;
 	context c;
-	parse_pdbqt_ligand(name, nrp, c);
+	parse_pdbqt_ligand_stream(name, in, nrp, c);
 
 	pdbqt_initializer tmp;
 	tmp.initialize_from_nrp(nrp, c, true);
 	tmp.initialize(nrp.mobility_matrix());
-
 	return tmp.m;
 }
 
-model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& rigidin,
-		const std::string& flex_name, std::istream& flexin) { // can throw parse_error
+static model receptor_from_lines(const std::string& rigid_name, pdbqt_lines& rigidin,
+		const std::string& flex_name, pdbqt_lines& flexin) {
 	rigid r;
 	non_rigid_parsed nrp;
 	context c;
@@ -521,7 +571,7 @@ model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& rigidin,
 	return tmp.m;
 }
 
-model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& in) { // can throw parse_error
+static model receptor_from_lines(const std::string& rigid_name, pdbqt_lines& in) {
 	rigid r;
 	parse_pdbqt_rigid(rigid_name, in, r);
 
@@ -531,3 +581,44 @@ model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& in) { //
 	tmp.initialize(mobility_matrix);
 	return tmp.m;
 }
+
+model parse_ligand_stream_pdbqt  (const std::string& name, std::istream& in) { // can throw parse_error
+	std::string text = read_stream(in);
+	pdbqt_lines lines = string_lines(text);
+	return ligand_from_lines(name, lines);
+}
+
+model parse_ligand_pdbqt  (const path& name) { // can throw parse_error
+	mapped_pdbqt file(name);
+	pdbqt_lines lines = file.lines();
+	return ligand_from_lines(name.string(), lines);
+}
+
+model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& rigidin,
+		const std::string& flex_name, std::istream& flexin) { // can throw parse_error
+	std::string rigidtext = read_stream(rigidin);
+	std::string flextext = read_stream(flexin);
+	pdbqt_lines rigidlines = string_lines(rigidtext);
+	pdbqt_lines flexlines = string_lines(flextext);
+	return receptor_from_lines(rigid_name, rigidlines, flex_name, flexlines);
+}
+
+model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& in) { // can throw parse_error
+	std::string text = read_stream(in);
+	pdbqt_lines lines = string_lines(text);
+	return receptor_from_lines(rigid_name, lines);
+}
+
+model parse_receptor_pdbqt(const path& rigid_name, const path& flex_name) { // can throw parse_error
+	mapped_pdbqt rigidfile(rigid_name);
+	mapped_pdbqt flexfile(flex_name);
+	pdbqt_lines rigidlines = rigidfile.lines();
+	pdbqt_lines flexlines = flexfile.lines();
+	return receptor_from_lines(rigid_name.string(), rigidlines, flex_name.string(), flexlines);
+}
+
+model parse_receptor_pdbqt(const path& rigid_name) { // can throw parse_error
+	mapped_pdbqt file(rigid_name);
+	pdbqt_lines lines = file.lines();
+	return receptor_from_lines(rigid_name.string(), lines);
+}
@@ -28,6 +28,9 @@
 model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& rigidin,
 		const std::string& flex_name, std::istream& flexin); // can throw parse_error
 model parse_receptor_pdbqt(const std::string& rigid_name, std::istream& in); // can throw parse_error
+//the files are mapped and parsed in place
+model parse_receptor_pdbqt(const path& rigid_name, const path& flex_name); // can throw parse_error
+model parse_receptor_pdbqt(const path& rigid_name); // can throw parse_error
 model parse_ligand_pdbqt(const path& name); // can throw parse_error
 model parse_ligand_stream_pdbqt(const std::string& name, std::istream& in);
 
@@ -241,7 +241,7 @@ void serialize(Archive & ar, parsing_struct::node_t<parsing_struct>& node, const
 	ar & node.ps;
 }
 
-extern void add_pdbqt_context(context& c, const std::string& str);
+extern void add_pdbqt_context(context& c, std::string_view str);
 extern void postprocess_ligand(non_rigid_parsed& nr, parsing_struct& p, context& c, unsigned torsdof);
 extern void postprocess_residue(non_rigid_parsed& nr, parsing_struct& p, context& c);
 
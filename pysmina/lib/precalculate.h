@@ -25,9 +25,14 @@
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/align/aligned_allocator.hpp>
+#include <atomic>
 #include "scoring_function.h"
 #include "matrix.h"
 #include "splines.h"
+#include "curl.h"
+#include "pair_plan.h"
+#include "parallel.h"
 
 //base class for precaluting classes
 class precalculate
@@ -45,7 +50,15 @@ public:
 	precalculate(const scoring_function& sf) : // sf should not be discontinuous, even near cutoff, for the sake of the derivatives
 			m_cutoff(sf.cutoff()),
 					m_cutoff_sqr(sqr(sf.cutoff())),
-					scoring(sf)
+					scoring(sf), m_serial(next_serial())
+	{
+
+	}
+
+	//a copy has its own tables, so plans compiled against rhs don't apply
+	precalculate(const precalculate& rhs) :
+			m_cutoff(rhs.m_cutoff), m_cutoff_sqr(rhs.m_cutoff_sqr),
+					scoring(rhs.scoring), m_serial(next_serial())
 	{
 
 	}
@@ -59,6 +72,41 @@ public:
 	{
 		return m_cutoff_sqr;
 	}
+
+	//identifies this instance for pair_plan, unique for the process lifetime
+	sz serial() const
+	{
+		return m_serial;
+	}
+
+	//must be called with the atom types of a model before evaluating it;
+	//approximations that tabulate type pairs build only what they're asked for
+	virtual void prepare(const std::vector<smt>& types, sz num_threads)
+	{
+	}
+
+	//append the pair (i, j) of atoms a, b to plan; returns false if this
+	//approximation can't evaluate plans, in which case the plan is discarded
+	virtual bool add_to_plan(const atom_base& a, const atom_base& b, sz i,
+			sz j, pair_plan& plan) const
+	{
+		return false;
+	}
+
+	//sum of the curled pair energies in a plan compiled by add_to_plan
+	virtual fl eval_plan(const pair_plan& plan, fl v, const vecv& coords) const
+	{
+		VINA_CHECK(false);
+		return 0;
+	}
+
+	//as eval_plan, also accumulating pair forces
+	virtual fl eval_plan_deriv(const pair_plan& plan, fl v,
+			const vecv& coords, vecv& forces) const
+	{
+		VINA_CHECK(false);
+		return 0;
+	}
 	bool has_components() const
 	{
 		return scoring.num_used_components() > 1;
@@ -80,67 +128,128 @@ public:
 		fl ret = eval_fast(a.get(), b.get(), r2).eval(a, b);
 		return ret + eval_slow(a, b, r2);
 	}
+
+	//true if types a and b get the same fast (precalculable) components
+	//against every type in partners at every sampled distance, so that a
+	//grid computed for one serves the other; sampled finer than the tables
+	bool equivalent_types(smt a, smt b, const std::vector<smt>& partners) const
+	{
+		if (a == b)
+			return true;
+		const sz samples = 4096;
+		VINA_FOR_IN(i, partners)
+		{
+			VINA_FOR(s, samples)
+			{
+				fl r2 = m_cutoff_sqr * s / samples;
+				result_components ca = eval_fast(partners[i], a, r2);
+				result_components cb = eval_fast(partners[i], b, r2);
+				VINA_FOR(c, result_components::size())
+					if (ca[c] != cb[c])
+						return false;
+			}
+		}
+		return true;
+	}
 protected:
 	fl m_cutoff;
 	fl m_cutoff_sqr;
 	const scoring_function& scoring;
 
+	//for when tables move and plans compiled against them are stale
+	void renew_serial()
+	{
+		m_serial = next_serial();
+	}
+
+private:
+	sz m_serial;
+
+	static sz next_serial()
+	{
+		static std::atomic<sz> counter(0);
+		return ++counter;
+	}
 };
 
 typedef std::vector<prv> prvv; //index by component, then point
-class precalculate_linear_element
+class precalculate_linear: public precalculate
 {
-	friend class precalculate_linear;
-	precalculate_linear_element(sz n, sz num_components, fl factor_) :
-			fast(n, flv(num_components, 0)),
-					smooth(num_components, prv(n, pr(0, 0))), //index by control point then by component
-					factor(factor_)
+	// One lookup table per pair of atom types (lower type first), all packed
+	// into a single aligned arena. A table is n records, one per control
+	// point r2 = i / factor; a record holds the num_components fast values
+	// followed by the (e, dor) pair of every component, so a lookup touches
+	// one record, or two adjacent ones for the derivative.
+	typedef std::vector<fl, boost::alignment::aligned_allocator<fl, 64> > arena;
+
+	//builds one table per call, for parallel_for
+	struct table_builder
 	{
+		precalculate_linear* p;
+		const std::vector<std::pair<smt, smt> >* pairs;
+		void operator()(sz i) const
+		{
+			smt t1 = (*pairs)[i].first;
+			smt t2 = (*pairs)[i].second;
+			p->build_table(t1, t2,
+					&p->tables[p->offsets[triangular_matrix_index(p->dim, t1,
+							t2)]]);
+		}
+	};
+
+	const fl* table(smt t1, smt t2) const //t1 <= t2
+	{
+		sz off = offsets[triangular_matrix_index(dim, t1, t2)];
+		VINA_CHECK(off != max_sz); //types weren't prepared
+		return &tables[off];
 	}
 
-	result_components eval_fast(fl r2) const
+	result_components table_fast(const fl* t, fl r2) const
 	{
-		assert(r2 * factor < fast.size());
+		assert(r2 * factor < n);
 		sz i = sz(factor * r2); // r2 is expected < cutoff_sqr, and cutoff_sqr * factor + 1 < n, so no overflow
-		assert(i < fast.size());
-		return fast[i];
+		assert(i < n);
+		const fl* rec = t + i * stride;
+		result_components ret;
+		VINA_FOR(c, num_components)
+			ret[c] = rec[c];
+		return ret;
 	}
 
-	pr eval_deriv(sz num_components, const atom_base& a, const atom_base& b,
-			fl r2) const
-			{
+	//charge factors as in result_components::eval
+	pr table_deriv(const fl* t, fl abs_a, fl abs_b, fl ab, fl r2) const
+	{
 		fl r2_factored = factor * r2;
-		assert(smooth.size() == num_components);
-		assert(r2_factored + 1 < smooth[0].size());
-		sz i1 = sz(r2_factored);
-		sz i2 = i1 + 1; // r2 is expected < cutoff_sqr, and cutoff_sqr * factor + 1 < n, so no overflow
-		assert(i1 < smooth[0].size());
-		assert(i2 < smooth[0].size());
+		assert(r2_factored + 1 < n);
+		sz i1 = sz(r2_factored); // i1 + 1 < n, see the constructor
+		assert(i1 + 1 < n);
 		fl rem = r2_factored - i1;
 		assert(rem >= -epsilon_fl);
 		assert(rem < 1 + epsilon_fl);
+		const fl* s1 = t + i1 * stride + num_components; //(e, dor) at i1
+		const fl* s2 = s1 + stride; //and at i1 + 1
 		fl e1, e2, d1, d2;
 		if (num_components == 1) //very slight speedup here
 		{
-			e1 = smooth[0][i1].first;
-			e2 = smooth[0][i2].first;
-			d1 = smooth[0][i1].second;
-			d2 = smooth[0][i2].second;
+			e1 = s1[0];
+			d1 = s1[1];
+			e2 = s2[0];
+			d2 = s2[1];
 		}
 		else
 		{
 			result_components e1comp, e2comp, d1comp, d2comp;
 			for (sz c = 0; c < num_components; c++)
 			{
-				e1comp[c] = smooth[c][i1].first;
-				e2comp[c] = smooth[c][i2].first;
-				d1comp[c] = smooth[c][i1].second;
-				d2comp[c] = smooth[c][i2].second;
+				e1comp[c] = s1[2 * c];
+				d1comp[c] = s1[2 * c + 1];
+				e2comp[c] = s2[2 * c];
+				d2comp[c] = s2[2 * c + 1];
 			}
-			e1 = e1comp.eval(a, b);
-			e2 = e2comp.eval(a, b);
-			d1 = d1comp.eval(a, b);
-			d2 = d2comp.eval(a, b);
+			e1 = e1comp.eval(abs_a, abs_b, ab);
+			e2 = e2comp.eval(abs_a, abs_b, ab);
+			d1 = d1comp.eval(abs_a, abs_b, ab);
+			d2 = d2comp.eval(abs_a, abs_b, ab);
 		}
 
 		fl e = e1 + rem * (e2 - e1);
@@ -148,66 +257,68 @@ class precalculate_linear_element
 		return pr(e, dor);
 	}
 
-	void init_from_smooth_fst(sz num_components, const flv& rs)
+	void build_table(smt t1, smt t2, fl* t) const
 	{
-		sz n = smooth[0].size();
-		VINA_CHECK(rs.size() >= n);
-		VINA_CHECK(fast.size() == n);
+		// e's at the control points
+		VINA_FOR(i, n)
+		{
+			result_components res = scoring.eval_fast(t1, t2, rs[i]);
+			for (sz c = 0; c < num_components; c++)
+				t[i * stride + num_components + 2 * c] = res[c];
+		}
 		for (sz c = 0; c < num_components; c++)
 		{
 			VINA_FOR(i, n)
 			{
+				fl* rec = t + i * stride;
+				fl f1 = rec[num_components + 2 * c];
 				// calculate dor's
-				fl& dor = smooth[c][i].second;
+				fl& dor = rec[num_components + 2 * c + 1];
 				if (i == 0 || i == n - 1)
 					dor = 0;
 				else
 				{
 					fl delta = rs[i + 1] - rs[i - 1];
 					fl r = rs[i];
-					dor = (smooth[c][i + 1].first - smooth[c][i - 1].first)
-							/ (delta * r);
+					const fl* next = rec + stride;
+					const fl* prev = rec - stride;
+					dor = (next[num_components + 2 * c]
+							- prev[num_components + 2 * c]) / (delta * r);
 				}
-				// calculate fast's from smooth.first's
-				fl f1 = smooth[c][i].first;
-				fl f2 = (i + 1 >= n) ? 0 : smooth[c][i + 1].first;
-				fast[i][c] = (f2 + f1) / 2;
+				// calculate fast's from the e's
+				fl f2 = (i + 1 >= n) ? 0 : rec[stride + num_components + 2 * c];
+				rec[c] = (f2 + f1) / 2;
 			}
 		}
-
 	}
 
-	std::vector<result_components> fast;
-	prvv smooth; // [(e, dor)] for each component, indexed first by component
-	fl factor;
-};
-
-class precalculate_linear: public precalculate
-{
 	//evaluate data while properly swapping types
 	result_components eval_fast_data(smt t1, smt t2, fl r2) const
 	{
 		if (t1 <= t2)
 		{
-			return data(t1, t2).eval_fast(r2);
+			return table_fast(table(t1, t2), r2);
 		}
 		else
 		{
-			result_components ret = data(t2, t1).eval_fast(r2);
+			result_components ret = table_fast(table(t2, t1), r2);
 			ret.swapOrder();
 			return ret;
 		}
 	}
 
 public:
+	// tables are only built by prepare
 	precalculate_linear(const scoring_function& sf, fl factor_) : // sf should not be discontinuous, even near cutoff, for the sake of the derivatives
 			precalculate(sf),
 					n(sz(factor_ * m_cutoff_sqr) + 3), // sz(factor * r^2) + 1 <= sz(factor * cutoff_sqr) + 2 <= n-1 < n  // see assert below
-					data(num_atom_types(),
-							precalculate_linear_element(n,
-									sf.num_used_components(), factor_)),
+					dim(num_atom_types()),
 					num_components(sf.num_used_components()),
-					factor(factor_)
+					factor(factor_),
+					stride(3 * num_components),
+					table_size((n * stride + 7) / 8 * 8), //whole 64 byte lines
+					offsets(dim * (dim + 1) / 2, max_sz),
+					prepared(dim, false)
 	{
 		VINA_CHECK(factor > epsilon_fl);
 		VINA_CHECK(sz(m_cutoff_sqr*factor) + 1 < n);
@@ -215,22 +326,53 @@ public:
 		VINA_CHECK(m_cutoff_sqr*factor + 1 < n);
 
 		calculate_rs();
+	}
 
-		VINA_FOR(t1, data.dim())
-			VINA_RANGE(t2, t1, data.dim())
+	//builds the tables for every pair among types and the types already
+	//prepared that doesn't have one yet, num_threads at a time
+	void prepare(const std::vector<smt>& types, sz num_threads)
+	{
+		VINA_FOR_IN(i, types)
+			if (types[i] < dim)
+				prepared[types[i]] = true;
+
+		std::vector<std::pair<smt, smt> > todo;
+		sz end = tables.size();
+		VINA_FOR(t1, dim)
+		{
+			if (!prepared[t1])
+				continue;
+			VINA_RANGE(t2, t1, dim)
 			{
-				precalculate_linear_element& p = data(t1, t2);
-				// init smooth[].first
-				VINA_FOR(i, n)
+				sz& off = offsets[triangular_matrix_index(dim, t1, t2)];
+				if (prepared[t2] && off == max_sz)
 				{
-					result_components res = sf.eval_fast((smt) t1, (smt) t2,
-							rs[i]);
-					for (sz c = 0; c < num_components; c++)
-						p.smooth[c][i].first = res[c];
+					off = end;
+					end += table_size;
+					todo.push_back(std::make_pair(smt(t1), smt(t2)));
 				}
-				// init the rest
-				p.init_from_smooth_fst(num_components, rs);
 			}
+		}
+		if (todo.empty())
+			return;
+
+		tables.resize(end, 0);
+		renew_serial(); //plans hold pointers into the old arena
+
+		table_builder builder;
+		builder.p = this;
+		builder.pairs = &todo;
+		num_threads = (std::min)(num_threads, todo.size());
+		if (num_threads <= 1)
+		{
+			VINA_FOR_IN(i, todo)
+				builder(i);
+		}
+		else
+		{
+			parallel_for<table_builder, true> pf(&builder, num_threads);
+			pf.run(todo.size());
+		}
 	}
 
 	result_components eval_fast(smt t1, smt t2, fl r2) const
@@ -246,9 +388,11 @@ public:
 		smt t2 = b.get();
 		pr ret;
 		if (t1 <= t2)
-			ret = data(t1, t2).eval_deriv(num_components, a, b, r2);
+			ret = table_deriv(table(t1, t2), std::abs(a.charge),
+					std::abs(b.charge), a.charge * b.charge, r2);
 		else
-			ret = data(t2, t1).eval_deriv(num_components, b, a, r2);
+			ret = table_deriv(table(t2, t1), std::abs(b.charge),
+					std::abs(a.charge), b.charge * a.charge, r2);
 
 		if (scoring.has_slow())
 		{
@@ -289,12 +433,75 @@ public:
 		return ret;
 	}
 
+	//pairs are stored with the lower type first so the table row needs no
+	//swapping; swapping a and b only flips the sign of the force
+	bool add_to_plan(const atom_base& a, const atom_base& b, sz i, sz j,
+			pair_plan& plan) const
+	{
+		if (scoring.has_slow() || i > pair_plan::max_index
+				|| j > pair_plan::max_index)
+			return false;
+		smt t1 = a.get();
+		smt t2 = b.get();
+		if (t1 <= t2)
+			plan.add(i, j, table(t1, t2), a.charge, b.charge);
+		else
+			plan.add(j, i, table(t2, t1), b.charge, a.charge);
+		return true;
+	}
+
+	fl eval_plan(const pair_plan& plan, fl v, const vecv& coords) const
+	{
+		fl e = 0;
+		VINA_FOR(k, plan.size())
+		{
+			fl r2 = vec_distance_sqr(coords[plan.a[k]], coords[plan.b[k]]);
+			if (r2 < m_cutoff_sqr)
+			{
+				fl tmp = table_fast(plan.rows[k], r2).eval(plan.abs_a[k],
+						plan.abs_b[k], plan.ab[k]);
+				curl(tmp, v);
+				e += tmp;
+			}
+		}
+		return e;
+	}
+
+	fl eval_plan_deriv(const pair_plan& plan, fl v, const vecv& coords,
+			vecv& forces) const
+	{
+		fl e = 0;
+		VINA_FOR(k, plan.size())
+		{
+			vec r;
+			r = coords[plan.b[k]] - coords[plan.a[k]]; // a -> b
+			fl r2 = sqr(r);
+			if (r2 < m_cutoff_sqr)
+			{
+				pr tmp = table_deriv(plan.rows[k], plan.abs_a[k],
+						plan.abs_b[k], plan.ab[k], r2);
+				vec force;
+				force = tmp.second * r;
+				curl(tmp.first, force, v);
+				e += tmp.first;
+				forces[plan.a[k]] -= force;
+				forces[plan.b[k]] += force;
+			}
+		}
+		return e;
+	}
+
 private:
 	sz n;
-	triangular_matrix<precalculate_linear_element> data;
-	flv rs; //actual distance of index locations
+	sz dim; //number of atom types
 	sz num_components;
 	fl factor;
+	sz stride; //fl's per record
+	sz table_size; //fl's per table, padded
+	szv offsets; //start of the table of each type pair, max_sz if not built
+	std::vector<bool> prepared; //by type
+	arena tables;
+	flv rs; //actual distance of index locations
 
 	void calculate_rs() //calculate square roots of control points once
 	{
@@ -304,7 +511,6 @@ private:
 	}
 };
 
-typedef std::pair<result_components, result_components> component_pair;
 //evaluates spline between two smina atom types as needed
 //will decompose charge dependent terms
 class spline_cache
@@ -475,7 +681,13 @@ public:
 
 		pr ret(rets.first.eval(a, b), rets.second.eval(a, b));
 
-		if (scoring.has_slow())
+		if (scoring.has_slow() && scoring.has_slow_deriv())
+		{
+			pr s = scoring.eval_slow_deriv(a, b, r);
+			ret.first += s.first;
+			ret.second += s.second;
+		}
+		else if (scoring.has_slow())
 		{
 			//compute value and numerical derivative directly from function
 			fl X = scoring.eval_slow(a, b, r);
@@ -523,13 +735,28 @@ public:
 		return scoring.eval_fast(t1, t2, r);
 	}
 
-	//numerical exact derivative - ignore cutoff for now
+	//analytic if the terms provide it, else numerical - ignore cutoff for now
 	pr eval_deriv(const atom_base& a, const atom_base& b, fl r2) const
 	{
 		smt ta = a.get();
 		smt tb = b.get();
 
 		fl r = sqrt(r2);
+		if (scoring.has_fast_deriv()
+				&& (!scoring.has_slow() || scoring.has_slow_deriv()))
+		{
+			component_pair res = scoring.eval_fast_deriv(ta, tb, r);
+			fl X = res.first.eval(a, b);
+			fl dx = res.second.eval(a, b);
+			if (scoring.has_slow())
+			{
+				pr s = scoring.eval_slow_deriv(a, b, r);
+				X += s.first;
+				dx += s.second;
+			}
+			return pr(X, dx / r);
+		}
+
 		result_components res = scoring.eval_fast(ta, tb, r);
 
 		fl X = res.eval(a, b);
@@ -0,0 +1,120 @@
+/*
+ * prepared_receptor.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "prepared_receptor.h"
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem/operations.hpp>
+#include "file.h"
+#include "my_pid.h"
+
+//the derived archives need the archive templates instantiated for them
+#include <boost/archive/impl/archive_serializer_map.ipp>
+#include <boost/archive/impl/basic_binary_oarchive.ipp>
+#include <boost/archive/impl/basic_binary_iarchive.ipp>
+#include <boost/archive/impl/basic_binary_oprimitive.ipp>
+#include <boost/archive/impl/basic_binary_iprimitive.ipp>
+
+template class boost::archive::detail::archive_serializer_map<exact_oarchive>;
+template class boost::archive::detail::archive_serializer_map<exact_iarchive>;
+template class boost::archive::basic_binary_oarchive<exact_oarchive>;
+template class boost::archive::basic_binary_iarchive<exact_iarchive>;
+template class boost::archive::basic_binary_oprimitive<exact_oarchive,
+		std::ostream::char_type, std::ostream::traits_type>;
+template class boost::archive::basic_binary_iprimitive<exact_iarchive,
+		std::istream::char_type, std::istream::traits_type>;
+
+static const std::string prepared_receptor_magic = "smina prepared receptor";
+static const unsigned prepared_receptor_version = 1;
+
+bool load_prepared_receptor(const std::string& path, const std::string& key,
+		model& m)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+	try
+	{
+		exact_iarchive ar(in,
+				boost::archive::no_header | boost::archive::no_tracking);
+		std::string magic, saved_key;
+		unsigned version = 0;
+		ar >> magic;
+		if (magic != prepared_receptor_magic)
+			return false;
+		ar >> version;
+		if (version != prepared_receptor_version)
+			return false;
+		ar >> saved_key;
+		if (saved_key != key)
+			return false;
+
+		model tmp;
+		ar >> tmp;
+		m = tmp;
+		return true;
+	} catch (std::exception& e)
+	{
+		//truncated or not ours (corrupt sizes surface as bad_alloc or
+		//length_error, not archive_exception), prepare again
+		return false;
+	}
+}
+
+bool save_prepared_receptor(const std::string& path, const std::string& key,
+		const model& m)
+{
+	std::string tmp = path + ".tmp" + boost::lexical_cast<std::string>(my_pid());
+	try
+	{
+		std::ofstream out(tmp.c_str(), std::ios::binary);
+		if (!out)
+			return false;
+		{
+			exact_oarchive ar(out,
+					boost::archive::no_header | boost::archive::no_tracking);
+			ar << prepared_receptor_magic;
+			ar << prepared_receptor_version;
+			ar << key;
+			ar << m;
+		}
+		out.close(); //flush errors, e.g. a full disk, only show up here
+		if (out)
+		{
+			boost::filesystem::rename(tmp, path);
+			return true;
+		}
+	} catch (std::exception& e)
+	{
+		//unwritable path, serialization or rename failure; docking goes on
+	}
+	boost::system::error_code ec;
+	boost::filesystem::remove(tmp, ec);
+	return false;
+}
+
+std::string file_content_hash(const std::string& path)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in)
+		return "";
+	uint64_t h = UINT64_C(14695981039346656037);
+	char buf[1 << 16];
+	while (in.read(buf, sizeof(buf)) || in.gcount() > 0)
+	{
+		std::streamsize n = in.gcount();
+		for (std::streamsize i = 0; i < n; i++)
+		{
+			h ^= (unsigned char) buf[i];
+			h *= UINT64_C(1099511628211);
+		}
+	}
+	std::stringstream str;
+	str << std::hex << h;
+	return str.str();
+}
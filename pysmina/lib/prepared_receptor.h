@@ -0,0 +1,75 @@
+/*
+ * prepared_receptor.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_PREPARED_RECEPTOR_H
+#define SMINA_PREPARED_RECEPTOR_H
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include "model.h"
+
+// Binary archives through which vec, atom_base and atom serialize at full
+// precision and with bonds (see exact_archive), so a model comes back exactly
+// as it was saved. The plain binary archives keep the compact .smina layout.
+class exact_oarchive: public boost::archive::binary_oarchive_impl<
+		exact_oarchive, std::ostream::char_type, std::ostream::traits_type>
+{
+public:
+	exact_oarchive(std::ostream& os, unsigned flags = 0) :
+			boost::archive::binary_oarchive_impl<exact_oarchive,
+					std::ostream::char_type, std::ostream::traits_type>(os,
+					flags)
+	{
+		init(flags);
+	}
+};
+
+class exact_iarchive: public boost::archive::binary_iarchive_impl<
+		exact_iarchive, std::istream::char_type, std::istream::traits_type>
+{
+public:
+	exact_iarchive(std::istream& is, unsigned flags = 0) :
+			boost::archive::binary_iarchive_impl<exact_iarchive,
+					std::istream::char_type, std::istream::traits_type>(is,
+					flags)
+	{
+		init(flags);
+	}
+};
+
+template<>
+struct exact_archive<exact_oarchive> : public boost::true_type
+{
+};
+
+template<>
+struct exact_archive<exact_iarchive> : public boost::true_type
+{
+};
+
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(exact_oarchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(exact_iarchive)
+
+// A receptor model saved after OpenBabel reading, hydrogens, charges,
+// flexible residue extraction and model initialization, together with a key
+// describing what it was prepared from. Loading one takes a fraction of the
+// time preparing it does, so runs and workers that share a receptor can
+// prepare it once.
+
+//returns false, leaving m alone, if the file is missing, unreadable or was
+//prepared from inputs with a different key
+bool load_prepared_receptor(const std::string& path, const std::string& key,
+		model& m);
+//written to a temporary name and then renamed, so concurrent readers never
+//see a partial file; the cache is best effort, so this returns false,
+//leaving nothing behind, instead of throwing if it can't be written
+bool save_prepared_receptor(const std::string& path, const std::string& key,
+		const model& m);
+
+//64 bit FNV-1a of the file's contents in hex, empty if it can't be read
+std::string file_content_hash(const std::string& path);
+
+#endif /* SMINA_PREPARED_RECEPTOR_H */
@@ -22,6 +22,8 @@
 
 #include "quasi_newton.h"
 #include "bfgs.h"
+#include "non_cache.h"
+#include <typeinfo>
 
 struct quasi_newton_aux {
 	model* m;
@@ -37,6 +39,14 @@ struct quasi_newton_aux {
 };
 
 void quasi_newton::operator()(model& m, const precalculate& p, const igrid& ig, output_type& out, change& g, const vec& v, const grid& user_grid) const { // g must have correct size
+	// a plain non_cache gets Verlet lists for the length of this minimization;
+	// subclasses (gpu) evaluate differently and are used as is
+	if(typeid(ig) == typeid(non_cache)) {
+		non_cache_verlet verlet(static_cast<const non_cache&>(ig));
+		quasi_newton_aux aux(&m, &p, &verlet, v, &user_grid);
+		out.e = bfgs(aux, out.c, g, average_required_improvement, params);
+		return;
+	}
 	quasi_newton_aux aux(&m, &p, &ig, v, &user_grid);
 	fl res = bfgs(aux, out.c, g, average_required_improvement, params);
 	out.e = res;
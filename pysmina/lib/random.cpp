@@ -26,27 +26,35 @@
 #include "my_pid.h"
 
 fl random_fl(fl a, fl b, rng& generator) { // expects a < b, returns rand in [a, b]
-	assert(a < b); // BOOST also asserts a < b
-	typedef boost::uniform_real<fl> distr;
-	boost::variate_generator<rng&, distr> r(generator, distr(a, b));
-	fl tmp = r();
+	assert(a < b);
+	fl tmp = a + (b - a) * generator.next_unit();
 	assert(tmp >= a);
 	assert(tmp <= b);
 	return tmp;
 }
 
 fl random_normal(fl mean, fl sigma, rng& generator) { // expects sigma >= 0
-	assert(sigma >= 0); // BOOST asserts this as well
-	typedef boost::normal_distribution<fl> distr;
-	boost::variate_generator<rng&, distr> r(generator, distr(mean, sigma));
-	return r();
+	assert(sigma >= 0);
+	// Box-Muller; 1 - u keeps the log argument in (0, 1]
+	fl u1 = 1 - generator.next_unit();
+	fl u2 = generator.next_unit();
+	return mean + sigma * std::sqrt(-2 * std::log(u1)) * std::cos(2 * pi * u2);
 }
 
 int random_int(int a, int b, rng& generator) { // expects a <= b, returns rand in [a, b]
-	assert(a <= b); // BOOST asserts this as well
-	typedef boost::uniform_int<int> distr;
-	boost::variate_generator<rng&, distr> r(generator, distr(a, b));
-	int tmp = r();
+	assert(a <= b);
+	// Lemire's multiply-shift with rejection, unbiased and division-free in the common case
+	const boost::uint64_t range = boost::uint64_t(boost::int64_t(b) - a) + 1; // <= 2^32
+	boost::uint64_t m = boost::uint64_t(generator()) * range;
+	boost::uint32_t low = boost::uint32_t(m);
+	if(low < range) {
+		const boost::uint32_t threshold = boost::uint32_t((boost::uint64_t(1) << 32) % range);
+		while(low < threshold) {
+			m = boost::uint64_t(generator()) * range;
+			low = boost::uint32_t(m);
+		}
+	}
+	int tmp = int(boost::int64_t(a) + boost::int64_t(m >> 32));
 	assert(tmp >= a);
 	assert(tmp <= b);
 	return tmp;
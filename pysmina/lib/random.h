@@ -23,10 +23,98 @@
 #ifndef VINA_RANDOM_H
 #define VINA_RANDOM_H
 
-#include <boost/random.hpp>
+#include <boost/cstdint.hpp>
 #include "common.h"
 
-typedef boost::mt19937 rng;
+// Philox4x32-10 counter-based generator (Salmon et al., SC'11).
+// The state is just (key, counter), so independent streams are obtained by
+// fixing the key to the seed and reserving the upper counter words for a
+// stream id; split() derives a child stream without touching the parent.
+// Satisfies the UniformRandomBitGenerator requirements.
+struct philox4x32 {
+	typedef boost::uint32_t result_type;
+
+	explicit philox4x32(result_type seed = 5489u, boost::uint64_t stream = 0) : buffered(4) {
+		key[0] = seed;
+		key[1] = 0xCA01F9DDu; // arbitrary, keeps key != 0 for seed 0
+		set_stream(stream);
+	}
+
+	// child stream keyed by (this stream, id); same seed, disjoint counters
+	philox4x32 split(boost::uint64_t id) const {
+		result_type in[4] = { result_type(stream), result_type(stream >> 32), result_type(id), result_type(id >> 32) };
+		result_type out[4];
+		philox4x32 child(*this);
+		child.block(in, out);
+		child.set_stream((boost::uint64_t(out[1]) << 32) | out[0]);
+		return child;
+	}
+
+	// split() along a path of ids, e.g. (ligand index, task index)
+	philox4x32 split(boost::uint64_t a, boost::uint64_t b) const {
+		return split(a).split(b);
+	}
+
+	boost::uint64_t stream_id() const { return stream; }
+
+	result_type operator()() {
+		if(buffered == 4) {
+			result_type in[4] = { result_type(counter), result_type(counter >> 32), result_type(stream), result_type(stream >> 32) };
+			block(in, buf);
+			++counter;
+			buffered = 0;
+		}
+		return buf[buffered++];
+	}
+
+	// 53 random bits scaled to [0, 1)
+	fl next_unit() {
+		boost::uint64_t hi = (*this)() >> 5;
+		boost::uint64_t lo = (*this)() >> 6;
+		return fl((hi << 26) | lo) * (1.0 / 9007199254740992.0);
+	}
+
+	static result_type min() { return 0; }
+	static result_type max() { return 0xFFFFFFFFu; }
+
+private:
+	result_type key[2];
+	boost::uint64_t stream;
+	boost::uint64_t counter;
+	result_type buf[4];
+	unsigned buffered;
+
+	void set_stream(boost::uint64_t s) {
+		stream = s;
+		counter = 0;
+		buffered = 4;
+	}
+
+	static void mulhilo(result_type a, result_type b, result_type& hi, result_type& lo) {
+		boost::uint64_t p = boost::uint64_t(a) * b;
+		hi = result_type(p >> 32);
+		lo = result_type(p);
+	}
+
+	void block(const result_type in[4], result_type out[4]) const {
+		result_type c0 = in[0], c1 = in[1], c2 = in[2], c3 = in[3];
+		result_type k0 = key[0], k1 = key[1];
+		VINA_FOR(r, 10) {
+			result_type hi0, lo0, hi1, lo1;
+			mulhilo(0xD2511F53u, c0, hi0, lo0);
+			mulhilo(0xCD9E8D57u, c2, hi1, lo1);
+			c0 = hi1 ^ c1 ^ k0;
+			c1 = lo1;
+			c2 = hi0 ^ c3 ^ k1;
+			c3 = lo0;
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+		out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+	}
+};
+
+typedef philox4x32 rng;
 
 fl random_fl(fl a, fl b, rng& generator); // expects a < b, returns rand in [a, b]
 fl random_normal(fl mean, fl sigma, rng& generator); // expects sigma >= 0
@@ -71,11 +71,17 @@ public:
 	}
 
 	fl eval(const atom_base& a, const atom_base& b) const
+	{
+		return eval(std::abs(a.charge), std::abs(b.charge), a.charge*b.charge);
+	}
+
+	//same as above with the charge factors already computed
+	fl eval(fl abs_a, fl abs_b, fl ab) const
 	{
 		return components[TypeDependentOnly] +
-					std::abs(a.charge)*components[AbsAChargeDependent] +
-					std::abs(b.charge)*components[AbsBChargeDependent] +
-					a.charge*b.charge*components[ABChargeDependent];
+					abs_a*components[AbsAChargeDependent] +
+					abs_b*components[AbsBChargeDependent] +
+					ab*components[ABChargeDependent];
 	}
 
 	//if you know the scoring function doesn't have charge dependencies
@@ -118,4 +124,6 @@ inline result_components operator*(const result_components& lhs, fl rhs)
 	return ret;
 }
 
+typedef std::pair<result_components, result_components> component_pair;
+
 #endif
@@ -13,6 +13,13 @@
 
 void result_info::setMolecule(const model &m)
 {
+	if (!m.hydrogens_current())
+	{ //searched moving heavy atoms only, place the hydrogens for output
+		model full(m);
+		full.set_hydrogens();
+		setMolecule(full);
+		return;
+	}
 	std::stringstream str;
 	if (m.write_sdf(str))
 	{
@@ -52,6 +59,13 @@ void result_info::writeAtomValues(std::ostream &out,
 //computes per-atom term values and formats them into the atominfo string
 void result_info::setAtomValues(const model &m, const weighted_terms *wt)
 {
+	if (!m.hydrogens_current())
+	{
+		model full(m);
+		full.set_hydrogens();
+		setAtomValues(full, wt);
+		return;
+	}
 	std::vector<flv> values;
 	const terms *t = wt->unweighted_terms();
 	t->evale_robust(m, values);
@@ -146,6 +160,9 @@ void result_info::write(std::ostream &out, std::string &ext,
 			out << std::fixed << std::setprecision(5) << rmsd << "\n\n";
 		}
 
+		if (truncated)
+			out << "> <searchTruncated>\n1\n\n";
+
 		std::stringstream astr;
 		writeAtomValues(astr, wt);
 		out << "> <atomic_interaction_terms>\n";
@@ -157,6 +174,8 @@ void result_info::write(std::ostream &out, std::string &ext,
 		out << "MODEL " << boost::lexical_cast<std::string>(modelnum) << "\n";
 		out << "REMARK minimizedAffinity " << boost::lexical_cast<std::string>((float)energy) << "\n";
 		out << "REMARK minimizedRMSD " << boost::lexical_cast<std::string>((float)rmsd) << "\n";
+		if (truncated)
+			out << "REMARK searchTruncated 1\n";
 		out << molstr;
 		out << "ENDMDL\n";
 	}
@@ -181,6 +200,10 @@ void result_info::write(std::ostream &out, std::string &ext,
 					   "minimizedRMSD",
 					   boost::lexical_cast<std::string>((float)rmsd));
 		}
+		if (truncated)
+		{
+			setMolData(format, mol, "searchTruncated", "1");
+		}
 		if (include_atom_terms)
 		{
 			std::stringstream astr;
@@ -217,6 +240,9 @@ void result_info::writeStr(std::stringstream &mystream, bool include_atom_terms,
 		mystream << std::fixed << std::setprecision(5) << rmsd << "\n\n";
 	}
 
+	if (truncated)
+		mystream << "> <searchTruncated>\n1\n\n";
+
 	if (include_atom_terms)
 	{
 		std::stringstream astr;
@@ -26,15 +26,19 @@ class result_info
 	fl rmsd;
 	fl rmsd_lb;
 	fl rmsd_ub;
+	bool truncated; //search hit its time limit, this is the best found so far
 public:
-	result_info() : energy(0), rmsd(-1), rmsd_lb(-1), rmsd_ub(-1), sdfvalid(false)
+	result_info() : energy(0), rmsd(-1), rmsd_lb(-1), rmsd_ub(-1), sdfvalid(false), truncated(false)
 	{
 	}
-	result_info(fl e, fl _rmsd, fl rmsd_lb, fl rmsd_ub, const model &m) : energy(e), rmsd(_rmsd), rmsd_lb(rmsd_lb), rmsd_ub(rmsd_ub), sdfvalid(false)
+	result_info(fl e, fl _rmsd, fl rmsd_lb, fl rmsd_ub, const model &m) : energy(e), rmsd(_rmsd), rmsd_lb(rmsd_lb), rmsd_ub(rmsd_ub), sdfvalid(false), truncated(false)
 	{
 		setMolecule(m);
 	}
 
+	void setTruncated(bool t) { truncated = t; }
+	bool isTruncated() const { return truncated; }
+
 	//set the molecular data using the current conformation of model m
 	void setMolecule(const model &m);
 
@@ -0,0 +1,65 @@
+/*
+ * rigid_cells.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "rigid_cells.h"
+
+rigid_cells::rigid_cells(const atomv& atoms, fl cutoff_sqr_, sz num_types) :
+		cell_size(std::sqrt(cutoff_sqr_) / 2), cutoff_sqr(cutoff_sqr_),
+				num_atoms(atoms.size())
+{
+	szv kept;
+	vec lo(max_fl, max_fl, max_fl), hi(-max_fl, -max_fl, -max_fl);
+	VINA_FOR_IN(i, atoms)
+	{
+		if (atoms[i].get() >= num_types)
+			continue;
+		kept.push_back(i);
+		for (sz d = 0; d < 3; d++)
+		{
+			lo[d] = (std::min)(lo[d], atoms[i].coords[d]);
+			hi[d] = (std::max)(hi[d], atoms[i].coords[d]);
+		}
+	}
+
+	if (kept.empty())
+	{
+		origin = zero_vec;
+		dims[0] = dims[1] = dims[2] = 0;
+		start.assign(1, 0);
+		return;
+	}
+
+	origin = lo;
+	sz ncells = 1;
+	for (sz d = 0; d < 3; d++)
+	{
+		dims[d] = cell_of(hi[d], d) + 1;
+		ncells *= dims[d];
+	}
+
+	//counting sort of the kept atoms by cell
+	szv cell(kept.size());
+	start.assign(ncells + 1, 0);
+	VINA_FOR_IN(k, kept)
+	{
+		const vec& c = atoms[kept[k]].coords;
+		cell[k] = (sz(cell_of(c[0], 0)) * dims[1] + cell_of(c[1], 1)) * dims[2]
+				+ cell_of(c[2], 2);
+		start[cell[k] + 1]++;
+	}
+	VINA_FOR(c, ncells)
+		start[c + 1] += start[c];
+
+	std::vector<unsigned> next(start.begin(), start.end() - 1);
+	indices.resize(kept.size());
+	coords.resize(kept.size());
+	VINA_FOR_IN(k, kept)
+	{
+		unsigned pos = next[cell[k]]++;
+		indices[pos] = kept[k];
+		coords[pos] = atoms[kept[k]].coords;
+	}
+}
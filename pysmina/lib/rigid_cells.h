@@ -0,0 +1,74 @@
+/*
+ * rigid_cells.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_RIGID_CELLS_H
+#define SMINA_RIGID_CELLS_H
+
+#include <cmath>
+#include "common.h"
+#include "atom.h"
+
+// Cell list over the rigid receptor atoms (model::grid_atoms), used to
+// score flexible residues against only the receptor atoms near them.
+// Cells are half the cutoff wide and stored compressed (one offset per
+// cell into a single index array), with coordinates copied next to the
+// indices so a query walks contiguous memory.
+// Immutable once built, so copies of a model can share one.
+class rigid_cells
+{
+	vec origin;
+	fl cell_size;
+	fl cutoff_sqr;
+	int dims[3];
+	std::vector<unsigned> start; //cell c holds entries [start[c], start[c+1])
+	szv indices;
+	vecv coords;
+	sz num_atoms; //size of the atomv this was built from
+
+	int cell_of(fl x, sz d) const
+	{
+		return int(std::floor((x - origin[d]) / cell_size));
+	}
+
+public:
+	//index the atoms with a type below num_types
+	rigid_cells(const atomv& atoms, fl cutoff_sqr_, sz num_types);
+
+	//true if this index is still good for these atoms and cutoff
+	bool matches(const atomv& atoms, fl cutoff_sqr_) const
+	{
+		return atoms.size() == num_atoms && cutoff_sqr == cutoff_sqr_;
+	}
+
+	//call f(j, r2) for every indexed atom j with r2 = |p - atoms[j]|^2 < cutoff^2
+	template<typename F>
+	void for_each_near(const vec& p, F f) const
+	{
+		int lo[3], hi[3];
+		for (sz d = 0; d < 3; d++)
+		{
+			int c = cell_of(p[d], d);
+			lo[d] = (std::max)(c - 2, 0);
+			hi[d] = (std::min)(c + 2, dims[d] - 1);
+			if (lo[d] > hi[d])
+				return;
+		}
+		for (int x = lo[0]; x <= hi[0]; x++)
+			for (int y = lo[1]; y <= hi[1]; y++)
+			{
+				sz row = (sz(x) * dims[1] + y) * dims[2];
+				for (sz k = start[row + lo[2]], end = start[row + hi[2] + 1];
+						k < end; k++)
+				{
+					fl r2 = vec_distance_sqr(p, coords[k]);
+					if (r2 < cutoff_sqr)
+						f(indices[k], r2);
+				}
+			}
+	}
+};
+
+#endif /* SMINA_RIGID_CELLS_H */
@@ -36,6 +36,13 @@ struct scoring_function {
 	virtual sz num_used_components() const = 0;
 	virtual fl eval_slow(const atom_base& a, const atom_base& b, fl r) const = 0;
 	virtual fl conf_independent(const model& m, fl e) const = 0;
+
+	//analytic derivatives with respect to r, (value, derivative); only
+	//available if has_fast_deriv/has_slow_deriv, else use finite differences
+	virtual bool has_fast_deriv() const { return false; }
+	virtual bool has_slow_deriv() const { return false; }
+	virtual component_pair eval_fast_deriv(smt t1, smt t2, fl r) const { return component_pair(); }
+	virtual pr eval_slow_deriv(const atom_base& a, const atom_base& b, fl r) const { return pr(0, 0); }
 	virtual ~scoring_function() {}
 };
 
@@ -0,0 +1,370 @@
+/*
+ * smina_library.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "smina_library.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/archive_exception.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <openbabel/obconversion.h>
+#include "SminaConverter.h"
+#include "obmolopener.h"
+#include "my_pid.h"
+
+namespace
+{
+
+const char library_magic[8] = { 'S', 'M', 'I', 'N', 'A', 'I', 'D', 'X' };
+const unsigned library_version = 2;
+const sz trailer_size = 40;
+
+void put_u32(std::string& s, uint32_t v)
+{
+	for (unsigned i = 0; i < 4; i++)
+		s += char((v >> (8 * i)) & 0xff);
+}
+
+void put_u64(std::string& s, uint64_t v)
+{
+	for (unsigned i = 0; i < 8; i++)
+		s += char((v >> (8 * i)) & 0xff);
+}
+
+uint32_t get_u32(const char *p)
+{
+	uint32_t v = 0;
+	for (unsigned i = 0; i < 4; i++)
+		v |= uint32_t((unsigned char) p[i]) << (8 * i);
+	return v;
+}
+
+uint64_t get_u64(const char *p)
+{
+	uint64_t v = 0;
+	for (unsigned i = 0; i < 8; i++)
+		v |= uint64_t((unsigned char) p[i]) << (8 * i);
+	return v;
+}
+
+struct library_trailer
+{
+	uint64_t index;
+	uint64_t count;
+	uint64_t metadata;
+	bool valid;
+
+	library_trailer(const char *p) :
+			index(get_u64(p)), count(get_u64(p + 8)), metadata(get_u64(p + 16))
+	{
+		valid = get_u32(p + 24) == library_version
+				&& std::equal(library_magic, library_magic + 8, p + 32);
+	}
+};
+
+std::pair<sz, sz> shard_range(sz n, sz i, sz k)
+{
+	return std::pair<sz, sz>(n * i / k, n * (i + 1) / k);
+}
+
+//the molecules of an input file, read as MolGetter reads them, so the
+//library holds the molecules docking the file would
+class molecule_source
+{
+	obmol_opener opener;
+	OpenBabel::OBConversion conv;
+
+public:
+	molecule_source(const std::string& fname)
+	{
+		opener.openForInput(conv, fname);
+	}
+
+	bool read(OpenBabel::OBMol& mol)
+	{
+		return conv.Read(&mol);
+	}
+
+	//the molecules left, each read in full so the count is exact
+	sz count()
+	{
+		sz n = 0;
+		OpenBabel::OBMol mol;
+		while (conv.Read(&mol))
+			n++;
+		return n;
+	}
+
+	//move past the next n molecules; formats OpenBabel can skip without
+	//parsing are skipped that way
+	bool skip(sz n)
+	{
+		if (n == 0)
+			return true;
+		OpenBabel::OBFormat *format = conv.GetInFormat();
+		int ret = format ? format->SkipObjects(int(n), &conv) : 0;
+		if (ret != 0) //0 if the format doesn't implement it
+			return ret > 0;
+		OpenBabel::OBMol mol;
+		for (sz i = 0; i < n; i++)
+		{
+			if (!conv.Read(&mol))
+				return false;
+		}
+		return true;
+	}
+};
+
+} //namespace
+
+bool smina_library::is_indexed(const path& fname)
+{
+	std::ifstream in(fname.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+	in.seekg(0, std::ios::end);
+	std::streamoff size = in.tellg();
+	if (size < std::streamoff(trailer_size))
+		return false;
+	char buf[trailer_size];
+	in.seekg(size - std::streamoff(trailer_size));
+	if (!in.read(buf, trailer_size))
+		return false;
+	return library_trailer(buf).valid;
+}
+
+bool smina_library::is_library(const path& fname)
+{
+	return fname.extension() == ".smina" && is_indexed(fname);
+}
+
+smina_library::smina_library(const path& name_) :
+		name(name_)
+{
+	if (!is_indexed(name))
+		throw parse_error(name, 0, "not an indexed smina library");
+	try
+	{
+		file.open(name.string());
+	} catch (std::exception& e)
+	{
+		throw file_error(name, true);
+	}
+
+	const char *data = file.data();
+	uint64_t end = file.size() - trailer_size;
+	library_trailer t(data + end);
+	if (t.index > end || t.count >= (end - t.index) / 8)
+		throw parse_error(name, 0, "corrupt library index");
+
+	offsets.resize(t.count + 1);
+	for (sz i = 0, n = offsets.size(); i < n; i++)
+	{
+		offsets[i] = get_u64(data + t.index + 8 * i);
+		if ((i == 0 && offsets[i] != 0) || (i > 0 && offsets[i] < offsets[i - 1]))
+			throw parse_error(name, 0, "corrupt library index");
+	}
+	if (offsets.back() != t.index)
+		throw parse_error(name, 0, "corrupt library index");
+
+	if (t.metadata != 0)
+	{
+		uint64_t pos = t.index + 8 * offsets.size();
+		if (t.metadata != pos)
+			throw parse_error(name, 0, "corrupt library metadata");
+		entries.resize(t.count);
+		for (sz i = 0, n = entries.size(); i < n; i++)
+		{
+			if (end - pos < 4)
+				throw parse_error(name, 0, "corrupt library metadata");
+			uint32_t len = get_u32(data + pos);
+			pos += 4;
+			if (end - pos < uint64_t(len) + 8)
+				throw parse_error(name, 0, "corrupt library metadata");
+			entries[i].name.assign(data + pos, len);
+			pos += len;
+			entries[i].heavy_atoms = get_u32(data + pos);
+			entries[i].torsions = get_u32(data + pos + 4);
+			pos += 8;
+		}
+	}
+}
+
+std::string_view smina_library::record(sz i) const
+{
+	return std::string_view(file.data() + offsets[i],
+			offsets[i + 1] - offsets[i]);
+}
+
+unsigned smina_library::read(sz i, parsing_struct& p, context& c) const
+{
+	std::string_view r = record(i);
+	unsigned torsdof = 0;
+	try
+	{
+		boost::iostreams::filtering_istream strm;
+		strm.push(boost::iostreams::gzip_decompressor());
+		strm.push(boost::iostreams::array_source(r.data(), r.size()));
+
+		boost::archive::binary_iarchive serialin(strm,
+				boost::archive::no_header | boost::archive::no_tracking);
+		serialin >> torsdof;
+		serialin >> p;
+		serialin >> c;
+	} catch (boost::archive::archive_exception& e)
+	{
+		throw parse_error(name, i + 1, "corrupt library record");
+	} catch (boost::iostreams::gzip_error& e)
+	{
+		throw parse_error(name, i + 1, "corrupt library record");
+	}
+	return torsdof;
+}
+
+std::pair<sz, sz> smina_library::shard(sz i, sz k) const
+{
+	return shard_range(size(), i, k);
+}
+
+smina_library_writer::smina_library_writer(const path& name_, bool metadata_) :
+		name(name_), pos(0), metadata(metadata_), closed(false)
+{
+	tmp = path(name.string() + ".tmp" + boost::lexical_cast<std::string>(my_pid()));
+	out.open(tmp.c_str(), std::ios::binary);
+	if (!out)
+		throw file_error(tmp, false);
+}
+
+smina_library_writer::~smina_library_writer()
+{
+	if (!closed)
+	{
+		out.close();
+		boost::system::error_code ec;
+		boost::filesystem::remove(tmp, ec);
+	}
+}
+
+bool smina_library_writer::add(OpenBabel::OBMol& mol)
+{
+	library_entry e;
+	e.name = mol.GetTitle();
+	mol.StripSalts(); //as when docking from the file
+	e.heavy_atoms = mol.NumHvyAtoms();
+
+	std::ostringstream rec;
+	try
+	{
+		e.torsions = SminaConverter::convertBinary(mol, rec);
+	} catch (parse_error& err)
+	{
+		std::cerr << "\n\nParse error with molecule " << e.name
+				<< " in file \"" << err.file.string() << "\": " << err.reason
+				<< '\n';
+		return false;
+	}
+	add(rec.str(), e);
+	return true;
+}
+
+void smina_library_writer::add(std::string_view record, const library_entry& e)
+{
+	offsets.push_back(pos);
+	out.write(record.data(), record.size());
+	pos += record.size();
+	if (metadata)
+		entries.push_back(e);
+}
+
+void smina_library_writer::close()
+{
+	std::string tail;
+	uint64_t index = pos;
+	for (sz i = 0, n = offsets.size(); i < n; i++)
+		put_u64(tail, offsets[i]);
+	put_u64(tail, index);
+
+	uint64_t meta = 0;
+	if (metadata)
+	{
+		meta = index + tail.size();
+		for (sz i = 0, n = entries.size(); i < n; i++)
+		{
+			put_u32(tail, entries[i].name.size());
+			tail += entries[i].name;
+			put_u32(tail, entries[i].heavy_atoms);
+			put_u32(tail, entries[i].torsions);
+		}
+	}
+
+	put_u64(tail, index);
+	put_u64(tail, offsets.size());
+	put_u64(tail, meta);
+	put_u32(tail, library_version);
+	put_u32(tail, 0);
+	tail.append(library_magic, 8);
+
+	out.write(tail.data(), tail.size());
+	out.close();
+	if (!out)
+		throw file_error(tmp, false);
+	boost::filesystem::rename(tmp, name);
+	closed = true;
+}
+
+sz count_library_input(const std::string& input)
+{
+	molecule_source src(input);
+	return src.count();
+}
+
+sz build_smina_library(const std::string& input, const path& output,
+		sz shard, sz num_shards, bool metadata, const boost::optional<sz>& size)
+{
+	//shards are contiguous, so the count decides where this one starts
+	sz n = size ? *size : count_library_input(input);
+	std::pair<sz, sz> range = shard_range(n, shard, num_shards);
+
+	smina_library_writer writer(output, metadata);
+	molecule_source src(input);
+	OpenBabel::OBMol mol;
+	if (src.skip(range.first))
+	{
+		for (sz i = range.first; i < range.second && src.read(mol); i++)
+			writer.add(mol);
+	}
+	writer.close();
+	return writer.size();
+}
+
+sz merge_smina_libraries(const std::vector<std::string>& inputs,
+		const path& output)
+{
+	std::vector<smina_library> libs;
+	bool metadata = true;
+	for (sz i = 0, n = inputs.size(); i < n; i++)
+	{
+		libs.push_back(smina_library(path(inputs[i])));
+		if (libs.back().size() > 0 && !libs.back().has_metadata())
+			metadata = false;
+	}
+
+	smina_library_writer writer(output, metadata);
+	library_entry none;
+	for (sz l = 0, nl = libs.size(); l < nl; l++)
+	{
+		const smina_library& lib = libs[l];
+		for (sz i = 0, n = lib.size(); i < n; i++)
+			writer.add(lib.record(i), metadata ? lib.entry(i) : none);
+	}
+	writer.close();
+	return writer.size();
+}
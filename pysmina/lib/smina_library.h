@@ -0,0 +1,141 @@
+/*
+ * smina_library.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_SMINA_LIBRARY_H
+#define SMINA_SMINA_LIBRARY_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <openbabel/mol.h>
+#include "parsing.h"
+#include "file.h"
+
+// Version 2 of the .smina ligand format. Molecules are stored as the same
+// gzip members convertBinary writes, one per molecule, so each decompresses
+// on its own. After them come an index of their offsets, an optional block
+// of per molecule metadata and a fixed size trailer locating both:
+//
+//   records   record 0 ... record n-1, starting at offset 0
+//   index     n+1 uint64 offsets, the last being the index's own
+//   metadata  per record: uint32 name length, name, uint32 heavy atoms,
+//             uint32 torsions
+//   trailer   uint64 index offset, uint64 n, uint64 metadata offset (0 if
+//             none), uint32 version, uint32 0, "SMINAIDX"
+//
+// all little endian. Any molecule, or contiguous shard of molecules, can be
+// read without decompressing the ones before it. A .smina file without the
+// trailer is read as before, as a single stream.
+
+struct library_entry
+{
+	std::string name;
+	unsigned heavy_atoms;
+	unsigned torsions;
+
+	library_entry() :
+			heavy_atoms(0), torsions(0)
+	{
+	}
+};
+
+class smina_library
+{
+	path name;
+	boost::iostreams::mapped_file_source file;
+	std::vector<uint64_t> offsets; //n+1
+	std::vector<library_entry> entries; //empty without metadata
+
+public:
+	//throws file_error if it can't be read, parse_error if it isn't an
+	//indexed library
+	smina_library(const path& name_);
+
+	//true if fname has the trailer of an indexed library
+	static bool is_indexed(const path& fname);
+
+	//true if fname is read as an indexed library when docking: a .smina file
+	//with the trailer (other .smina files are read as one stream)
+	static bool is_library(const path& fname);
+
+	sz size() const
+	{
+		return offsets.size() - 1;
+	}
+
+	bool has_metadata() const
+	{
+		return entries.size() > 0;
+	}
+
+	const library_entry& entry(sz i) const
+	{
+		return entries[i];
+	}
+
+	//the compressed bytes of molecule i
+	std::string_view record(sz i) const;
+
+	//decompress molecule i, return numtors
+	unsigned read(sz i, parsing_struct& p, context& c) const;
+
+	//[first, last) of shard i of k; shards are contiguous, in order and
+	//differ in size by at most one
+	std::pair<sz, sz> shard(sz i, sz k) const;
+};
+
+// Writes an indexed library to a temporary name that is renamed into place
+// by close, so a library is either complete or absent.
+class smina_library_writer
+{
+	path name;
+	path tmp;
+	std::ofstream out;
+	uint64_t pos;
+	std::vector<uint64_t> offsets;
+	std::vector<library_entry> entries;
+	bool metadata;
+	bool closed;
+
+public:
+	smina_library_writer(const path& name_, bool metadata_ = true);
+	~smina_library_writer(); //removes the temporary if not closed
+
+	//convert and append mol, return false if it couldn't be converted
+	bool add(OpenBabel::OBMol& mol);
+	//append an already compressed record
+	void add(std::string_view record, const library_entry& e);
+
+	sz size() const
+	{
+		return offsets.size();
+	}
+
+	//write the index and trailer and move the library into place
+	void close();
+};
+
+//the number of molecules in input that build_smina_library shards
+sz count_library_input(const std::string& input);
+
+//convert shard of num_shards (as in smina_library::shard) of the molecules
+//in input into a library at output; return the number written. size is
+//count_library_input(input), counted here if not given, so jobs building
+//the shards of one input can share a single count
+sz build_smina_library(const std::string& input, const path& output,
+		sz shard = 0, sz num_shards = 1, bool metadata = true,
+		const boost::optional<sz>& size = boost::none);
+
+//concatenate libraries in order; metadata is kept if all of them have it
+sz merge_smina_libraries(const std::vector<std::string>& inputs,
+		const path& output);
+
+#endif /* SMINA_SMINA_LIBRARY_H */
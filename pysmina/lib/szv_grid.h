@@ -30,6 +30,7 @@
 
 #include <boost/unordered_map.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace boost
 {
@@ -52,12 +53,14 @@ inline std::size_t hash_value(const array<int, 3> &e)
 
 //dkoes - this is a 'global' cache of receptor atoms that are within a cutoff
 //distance from global grid points; the atom lists are calculated on demand
-//and stored in a hash
+//and stored in a hash; threads share it, coming here only for cells their
+//own szv_grid hasn't looked up yet
 class szv_grid_cache
 {
 	typedef boost::array<int, 3> ijk;
 	typedef boost::unordered_map<ijk, szv*> cache_type;
 	mutable cache_type cache;
+	mutable boost::mutex cache_lock; //guards cache
 	const model& m;
 	fl cutoff_sqr;
 	static const fl granularity; // = 3.0 - good balance of cache locality and avoiding redundant computation
@@ -126,6 +129,17 @@ public:
 		return ret;
 	}
 
+	//inverse of local_index: the center of a local cell
+	static vec cell_center(const ijk& index, const ijk& offset)
+	{
+		vec ret;
+		for (sz i = 0; i < 3; i++)
+		{
+			ret[i] = (index[i] + offset[i] + 0.5) * granularity;
+		}
+		return ret;
+	}
+
 	//return pointer to possibilities vector from cache
 	//the value is generated on-demand looking just at the receptor
 	//atoms in relvant_indices if necessary
@@ -138,7 +152,9 @@ public:
 			index[i] = std::floor(coord[i] / granularity);
 		}
 
-		if (cache.count(index) == 0)
+		boost::mutex::scoped_lock lk(cache_lock);
+		cache_type::const_iterator found = cache.find(index);
+		if (found == cache.end())
 		{
 			//fill out the list of close enough receptor atoms
 			szv *atoms = new szv();
@@ -146,8 +162,9 @@ public:
 			vec lower, upper;
 			for (sz i = 0; i < 3; i++)
 			{
-				lower[i] = std::floor(coord[i] / granularity) * granularity;
-				upper[i] = std::ceil(coord[i] / granularity) * granularity;
+				//not ceil: a coord on a cell boundary would give an empty brick
+				lower[i] = index[i] * granularity;
+				upper[i] = lower[i] + granularity;
 			}
 			VINA_FOR_IN(ri, relevant_indices)
 			{
@@ -160,8 +177,9 @@ public:
 				}
 			}
 			cache[index] = atoms;
+			return atoms;
 		}
-		return cache[index];
+		return found->second;
 	}
 
 	//return the dimension of the grid for given dimensions
@@ -209,6 +227,23 @@ struct szv_grid
 		}
 		return *ret;
 	}
+
+	//append the possibilities of every cell overlapping the box [lo, hi],
+	//which must be inside the grid; the result may contain duplicates
+	void possibilities(const vec& lo, const vec& hi, szv& out) const
+	{
+		boost::array<int, 3> first = cache.local_index(lo, offset);
+		boost::array<int, 3> last = cache.local_index(hi, offset);
+		boost::array<int, 3> index;
+		for (index[0] = first[0]; index[0] <= last[0]; index[0]++)
+			for (index[1] = first[1]; index[1] <= last[1]; index[1]++)
+				for (index[2] = first[2]; index[2] <= last[2]; index[2]++)
+				{
+					const szv& cell = possibilities(cache.cell_center(index, offset));
+					out.insert(out.end(), cell.begin(), cell.end());
+				}
+	}
+
 	private:
 	szv_grid_cache& cache;
 	szv relevant_indexes; //rec atoms within distance of docking grid
@@ -40,14 +40,13 @@ enum TermKind {BaseTerm, ConfIndependent, InterMolecular, Additive,  DistanceAdd
 
 struct term
 {
-	boost::regex rexpr;
 	std::string name;
 	virtual ~term()
 	{
 	}
 
 	//every term must be able to create a new term from string description
-	//of the paramerterized term
+	//of the paramerterized term; patterns are compiled once, on first use
 	virtual term* createFrom(const std::string& name) const = 0;
 
 	virtual TermKind kind() const {
@@ -70,6 +69,18 @@ struct distance_additive: public term
 	{
 	}
 
+	//terms that know their derivative return true and implement eval_deriv,
+	//which returns the value and its derivative with respect to r
+	virtual bool has_deriv() const
+	{
+		return false;
+	}
+	virtual pr eval_deriv(const atom_base& a, const atom_base& b, fl r) const
+	{
+		VINA_CHECK(false);
+		return pr(0, 0);
+	}
+
 	virtual term* createFrom(const std::string& name) const = 0;
 
 	virtual TermKind kind() const {
@@ -93,6 +104,19 @@ struct charge_dependent: public distance_additive
 		return c.eval(a,b);
 	}
 
+	//components of the value and of its derivative, if has_deriv
+	virtual component_pair eval_components_deriv(smt t1, smt t2, fl r) const
+	{
+		VINA_CHECK(false);
+		return component_pair();
+	}
+
+	pr eval_deriv(const atom_base& a, const atom_base& b, fl r) const
+	{
+		component_pair c = eval_components_deriv(a.sm, b.sm, r);
+		return pr(c.first.eval(a, b), c.second.eval(a, b));
+	}
+
 	virtual term* createFrom(const std::string& name) const = 0;
 
 	virtual TermKind kind() const {
@@ -118,6 +142,15 @@ struct charge_independent: public distance_additive
 		VINA_CHECK(false);
 		return 0;
 	}
+	pr eval_deriv(const atom_base& a, const atom_base& b, fl r) const
+	{
+		return eval_deriv(a.get(), b.get(), r);
+	}
+	virtual pr eval_deriv(smt t1, smt t2, fl r) const
+	{
+		VINA_CHECK(false);
+		return pr(0, 0);
+	}
 	virtual ~charge_independent()
 	{
 	}
@@ -199,7 +232,7 @@ struct conf_independent: public term
 			flv::const_iterator& it) const = 0;
 	virtual sz size() const = 0; // how many parameters does it take
 
-	//assume these are unparamerterized and so just have to match regex
+	//assume these are unparamerterized and so just have to match the name
 	virtual term* createFrom(const std::string& name) const = 0;
 
 	virtual TermKind kind() const {
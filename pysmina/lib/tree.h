@@ -50,6 +50,7 @@ protected:
 	mat orientation_m;
 
 	frame() {}
+	friend class flat_tree;
 	friend class boost::serialization::access;
 	template<class Archive>
 	void serialize(Archive& ar, const unsigned version) {
@@ -140,6 +141,7 @@ protected:
 	vec axis;
 
 	axis_frame() {}
+	friend class flat_tree;
 	friend class boost::serialization::access;
 	template<class Archive>
 	void serialize(Archive& ar, const unsigned version) {
@@ -173,6 +175,7 @@ private:
 	vec relative_axis;
 	vec relative_origin;
 
+	friend class flat_tree;
 	friend class boost::serialization::access;
 	template<class Archive>
 	void serialize(Archive& ar, const unsigned version) {
@@ -0,0 +1,64 @@
+/*
+ * type_groups.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMINA_TYPE_GROUPS_H
+#define SMINA_TYPE_GROUPS_H
+
+#include "atom.h"
+
+// The movable heavy atoms of a model grouped by atom type, so grid lookups
+// can run over a block of atoms that all use the same grid.  Atoms that
+// grids don't score (hydrogens, unknown types) are listed separately.
+struct type_groups
+{
+	szv atoms; //movable atom indices, ordered by type
+	szv starts; //atoms of types[k] are atoms[starts[k]..starts[k+1])
+	std::vector<smt> types;
+	szv skipped; //movable atoms without a grid
+	sz built_for; //number of model atoms when built
+
+	type_groups() :
+			built_for(max_sz)
+	{
+	}
+
+	bool current(sz num_atoms) const
+	{
+		return built_for == num_atoms;
+	}
+
+	void build(const atomv& all, sz num_movable)
+	{
+		const sz nat = num_atom_types();
+		std::vector<std::pair<smt, sz> > typed;
+		atoms.clear();
+		starts.clear();
+		types.clear();
+		skipped.clear();
+		VINA_FOR(i, num_movable)
+		{
+			smt t = all[i].get();
+			if (t >= nat || is_hydrogen(t))
+				skipped.push_back(i);
+			else
+				typed.push_back(std::make_pair(t, i));
+		}
+		std::sort(typed.begin(), typed.end());
+		VINA_FOR_IN(i, typed)
+		{
+			if (types.empty() || types.back() != typed[i].first)
+			{
+				types.push_back(typed[i].first);
+				starts.push_back(i);
+			}
+			atoms.push_back(typed[i].second);
+		}
+		starts.push_back(atoms.size());
+		built_for = all.size();
+	}
+};
+
+#endif /* SMINA_TYPE_GROUPS_H */
@@ -23,7 +23,7 @@
 #include "weighted_terms.h"
 
 //dkoes - FIX: terms and weights must be in a specific order (usable, da, const)
-weighted_terms::weighted_terms(const terms* t, const flv& weights) : t(t), weights(weights), cutoff_(0),conf_indep_start(0) { // does not own t
+weighted_terms::weighted_terms(const terms* t, const flv& weights) : t(t), weights(weights), cutoff_(0),conf_indep_start(0), fast_deriv(true), slow_deriv(true) { // does not own t
 	VINA_CHECK(t->         additive_terms.num_enabled() == 0);
 	VINA_CHECK(t->   intermolecular_terms.num_enabled() == 0);
 
@@ -31,17 +31,20 @@ weighted_terms::weighted_terms(const terms* t, const flv& weights) : t(t), weigh
 		if(t->charge_independent_terms.enabled[i]) {
 			enabled_charge_independent_terms.push_back(i);
 			cutoff_ = (std::max)(cutoff_, t->charge_independent_terms[i].cutoff);
+			fast_deriv = fast_deriv && t->charge_independent_terms[i].has_deriv();
 		}
 	VINA_FOR_IN(i, t->charge_dependent_terms)
 		if(t->charge_dependent_terms.enabled[i]) {
 			enabled_charge_dependent_terms.push_back(i);
 			cutoff_ = (std::max)(cutoff_, t->charge_dependent_terms[i].cutoff);
+			fast_deriv = fast_deriv && t->charge_dependent_terms[i].has_deriv();
 		}
 
 	VINA_FOR_IN(i, t->distance_additive_terms)
 		if(t->distance_additive_terms.enabled[i]) {
 			enabled_distance_additive_terms.push_back(i);
 			cutoff_ = (std::max)(cutoff_, t->distance_additive_terms[i].cutoff);
+			slow_deriv = slow_deriv && t->distance_additive_terms[i].has_deriv();
 		}
 
 	conf_indep_start = enabled_charge_independent_terms.size() +
@@ -71,6 +74,35 @@ fl weighted_terms::eval_slow(const atom_base& a, const atom_base& b, fl r) const
 	return acc;
 }
 
+//as eval_fast, with the derivative with respect to r
+component_pair weighted_terms::eval_fast_deriv(smt t1, smt t2, fl r) const {
+	component_pair acc;
+	VINA_FOR_IN(i, enabled_charge_independent_terms) {
+		pr tmp = t->charge_independent_terms[enabled_charge_independent_terms[i]].eval_deriv(t1, t2, r);
+		acc.first[result_components::TypeDependentOnly] += weights[i] * tmp.first;
+		acc.second[result_components::TypeDependentOnly] += weights[i] * tmp.second;
+	}
+
+	sz offset = enabled_charge_independent_terms.size();
+	VINA_FOR_IN(i, enabled_charge_dependent_terms) {
+		component_pair tmp = t->charge_dependent_terms[enabled_charge_dependent_terms[i]].eval_components_deriv(t1, t2, r);
+		acc.first += tmp.first * weights[offset+i];
+		acc.second += tmp.second * weights[offset+i];
+	}
+	return acc;
+}
+
+pr weighted_terms::eval_slow_deriv(const atom_base& a, const atom_base& b, fl r) const {
+	pr acc(0, 0);
+	sz offset = enabled_charge_independent_terms.size() + enabled_charge_dependent_terms.size();
+	VINA_FOR_IN(i, enabled_distance_additive_terms) {
+		pr tmp = t->distance_additive_terms[enabled_distance_additive_terms[i]].eval_deriv(a, b, r);
+		acc.first += weights[offset+i] * tmp.first;
+		acc.second += weights[offset+i] * tmp.second;
+	}
+	return acc;
+}
+
 fl weighted_terms::conf_independent(const model& m, fl e) const {
 	flv::const_iterator it = weights.begin() + conf_indep_start;
 	conf_independent_inputs in(m); // FIXME quite inefficient, but I think speed is irrelevant here, right?
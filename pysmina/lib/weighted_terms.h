@@ -38,6 +38,12 @@ struct weighted_terms: public scoring_function
 	result_components eval_fast(smt t1, smt t2, fl r) const; // intentionally not checking for cutoff
 	fl eval_slow(const atom_base& a, const atom_base& b, fl r) const; //dkoes - da terms
 
+	//true if every enabled term of the kind provides an analytic derivative
+	bool has_fast_deriv() const { return fast_deriv; }
+	bool has_slow_deriv() const { return slow_deriv; }
+	component_pair eval_fast_deriv(smt t1, smt t2, fl r) const;
+	pr eval_slow_deriv(const atom_base& a, const atom_base& b, fl r) const;
+
 	fl conf_independent(const model& m, fl e) const;
 
 	//dkoes - return true if has slow terms that can't be precalculated
@@ -70,7 +76,7 @@ struct weighted_terms: public scoring_function
 	}
 private:
 	weighted_terms() :
-			t(NULL), cutoff_(0), conf_indep_start(0)
+			t(NULL), cutoff_(0), conf_indep_start(0), fast_deriv(false), slow_deriv(false)
 	{
 	}
 	const terms* t;
@@ -80,6 +86,8 @@ private:
 	szv enabled_charge_independent_terms;
 	szv enabled_charge_dependent_terms;
 	szv enabled_distance_additive_terms; //additive currently aren't supported
+	bool fast_deriv;
+	bool slow_deriv;
 };
 
 #endif
@@ -0,0 +1,59 @@
+# -*- coding: utf-8 -*-
+"""
+
+## library
+
+Build indexed .smina ligand libraries from sdf files using several processes.
+
+Example:
+
+```python
+from pysmina import library, sminalib
+
+library.build(['actives.sdf', 'decoys.sdf.gz'], 'screen.smina', processes=8)
+print(sminalib.library_size('screen.smina'))
+# each worker docks its own part of the library
+params = dict(receptor='receptor.pdbqt', ligand='screen.smina',
+              autobox_ligand='ligand.pdbqt', shard=0, num_shards=4)
+sdfs: str = sminalib.run(params)
+```
+
+"""
+
+import os
+import multiprocessing
+
+from pysmina import sminalib
+
+
+def _count(name):
+    return sminalib.count_molecules(name)
+
+
+def _build_shard(job):
+    return sminalib.build_library(*job)
+
+
+def build(inputs, output: str, processes: int = None, metadata: bool = True) -> int:
+    """Convert inputs (a path or list of paths) into one indexed library at
+    output, in input order. Each input is counted once and split into one
+    contiguous shard per process; the shards are converted in parallel and
+    then merged. Returns the number of molecules in the library."""
+    if isinstance(inputs, str):
+        inputs = [inputs]
+    processes = processes or multiprocessing.cpu_count()
+    parts = [[f'{output}.{i}.{shard}.part' for shard in range(processes)]
+             for i in range(len(inputs))]
+    try:
+        with multiprocessing.Pool(processes) as pool:
+            sizes = pool.map(_count, inputs)
+            jobs = [(name, parts[i][shard], shard, processes, metadata, sizes[i])
+                    for i, name in enumerate(inputs)
+                    for shard in range(processes)]
+            pool.map(_build_shard, jobs)
+        return sminalib.merge_libraries([part for ps in parts for part in ps], output)
+    finally:
+        for ps in parts:
+            for part in ps:
+                if os.path.exists(part):
+                    os.remove(part)